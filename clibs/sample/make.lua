@@ -62,6 +62,7 @@ local function compile_shader(src, name)
 end
 
 local sample_shader = compile_shader("extlua/perspective_quad.glsl", "perspective_quad.glsl.h")
+local tint_shader = compile_shader("extlua/tint_quad.glsl", "tint_quad.glsl.h")
 
 lm:dll "sample" {
 	sources = {
@@ -71,6 +72,7 @@ lm:dll "sample" {
 	},
 	objdeps = {
 		sample_shader,
+		tint_shader,
 	},
 	includes = {
 		"3rd/lua",
@@ -3,6 +3,7 @@ local fs = require "bee.filesystem"
 
 local fs_basedir = lm.fs_basedir
 
+-- luamake -lua_strip on : embed lua bytecode without debug information
 local function compile_lua_code(script, src, name)
 	local dep = name .. "_lua_code"
 	local target = lm.basedir / lm.builddir / name
@@ -22,6 +23,7 @@ local function compile_lua_code(script, src, name)
 			lm.basedir / script,
 			"$in",
 			"$out",
+			lm.lua_strip == "on" and "strip" or nil,
 		},
 	}
 	return dep
@@ -60,10 +60,15 @@ local function shader_lang()
 	return "unknown"
 end
 
+-- blocks shared by other shaders with @include, they have no program
+local include_only = {
+	["srdecode.glsl"] = true,
+}
+
 return function(objdeps)
 	for path in fs.pairs(fs_basedir / "src") do
 		local lang = shader_lang()
-		if path:extension() == ".glsl" then
+		if path:extension() == ".glsl" and not include_only[path:filename():string()] then
 			local base = path:stem():string()
 			local dep = compile_shader(path:string(), base .. ".glsl.h", lang)
 			objdeps[#objdeps + 1] = dep
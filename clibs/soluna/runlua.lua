@@ -1,12 +1,12 @@
 local subprocess = require "bee.subprocess"
 local platform = require "bee.platform"
 
-local bindir, script, src, target = ...
+local bindir, script, src, target, mode = ...
 
 local luaexe = platform.os == "windows" and bindir .. "/lua.exe" or bindir .. "/lua"
 
 local process = assert(subprocess.spawn {
-	luaexe, script, src, target,
+	luaexe, script, src, target, mode,
 })
 
 local code = process:wait()
@@ -0,0 +1,49 @@
+---@meta soluna.arena
+
+---帧内存统计
+---Frame arena statistics.
+---@class soluna.arena.Stat
+---@field bytes integer 上一帧分配的字节数 / Bytes allocated in the last frame
+---@field count integer 上一帧的分配次数 / Allocations in the last frame
+---@field overflow integer 上一帧超出预留内存的分配次数 / Allocations out of the reserved memory in the last frame
+---@field peak integer 单帧最大分配字节数 / Max bytes allocated in one frame
+---@field capacity integer 两个缓冲区预留的总字节数 / Bytes reserved by both halves
+
+---帧内存：双缓冲的线性分配器，第 N 帧分配的内存在第 N+1 帧结束时失效，不需要释放
+---Frame arena: a double buffered linear allocator. Memory allocated in frame N is valid until the end of frame N+1, and is never freed.
+---@class soluna.arena
+local arena = {}
+
+---预留每个缓冲区的大小，由 render 服务按 `frame_arena_size` 设置调用
+---Reserves the size of each half, called by the render service with the `frame_arena_size` setting.
+---@param size integer 字节数 / Bytes
+function arena.init(size)
+end
+
+---结束一帧，由 render 服务在每帧末尾调用
+---Ends a frame, called by the render service at the end of each frame.
+function arena.swap()
+end
+
+---分配帧内存
+---Allocates frame memory.
+---@param size integer 字节数 / Bytes
+---@return lightuserdata ptr 16 字节对齐的指针 / 16 bytes aligned pointer
+function arena.alloc(size)
+end
+
+---把字符串复制到帧内存，返回引用帧内存的外部字符串
+---Copies a string into frame memory and returns an external string referring to it.
+---@param str string 源字符串 / Source string
+---@return string str 帧生命周期的字符串 / String with frame lifetime
+---@return lightuserdata ptr 字符串数据指针 / Pointer to the string data
+function arena.string(str)
+end
+
+---返回上一帧的统计
+---Returns the statistics of the last frame.
+---@return soluna.arena.Stat stat
+function arena.stat()
+end
+
+return arena
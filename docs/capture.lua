@@ -0,0 +1,70 @@
+---@meta soluna.capture
+
+---帧捕获与回放，设置 frame_capture 时写入每帧的批次流，设置 frame_replay 时回放
+---Frame capture and replay. Setting frame_capture writes the batch streams of every frame, frame_replay draws them back.
+---
+---文件格式（本机字节序，只能在同一平台回放）
+---File format (native endian, replay on the same platform only):
+---
+---  header : magic "SOLUNACP" (8 bytes), version (uint32 = 1), materials (uint32 size + string)
+---  frame  : stream number (uint32), each stream : primitive number (uint32), padding to 16 bytes, draw_primitive[]
+---  end    : 0xffffffff (uint32), texture_n (uint32), rects (uint32 size + bytes)
+---
+---frame 可重复任意次，至少要有一帧；end 记录捕获结束时的精灵库
+---Frames repeat any number of times, at least one is required; end records the sprite bank when the capture is closed.
+---@class soluna.capture
+local capture = {}
+
+---@class soluna.capture.writer
+local writer = {}
+
+---写入一帧
+---Writes a frame.
+---@param streams table 流列表 { ptr1, n1, ptr2, n2, ... } / Stream list
+---@param n integer 流数量 / Stream number
+function writer:frame(streams, n)
+end
+
+---写入结束标记和精灵库并关闭文件
+---Writes the end marker and the sprite bank, then closes the file.
+---@param rects string 精灵库数据，来自 bank:dump() / Sprite bank data from bank:dump()
+---@param texture_n integer 纹理数量 / Texture number
+function writer:close(rects, texture_n)
+end
+
+---@class soluna.capture.reader
+---@operator len: integer
+local reader = {}
+
+---取得一帧的流，指针在 reader 存活期间有效
+---Fills the streams of a frame; the pointers are valid as long as the reader is alive.
+---@param index integer 帧序号，从 1 开始 / Frame index, 1-based
+---@param streams table 待填充的流列表 / Stream list to fill
+---@return integer n 流数量 / Stream number
+function reader:frame(index, streams)
+end
+
+---返回文件头和结束段的数据
+---Returns the header and end data.
+---@return string materials 材质名 / Material names
+---@return string rects 精灵库数据 / Sprite bank data
+---@return integer texture_n 纹理数量 / Texture number
+function reader:header()
+end
+
+---创建捕获文件
+---Creates a capture file.
+---@param filename string 文件名 / File name
+---@param materials string 材质名 / Material names
+---@return soluna.capture.writer
+function capture.writer(filename, materials)
+end
+
+---打开捕获文件，没有帧或被截断的文件会报错
+---Opens a capture file; raises an error if it has no frame or is truncated.
+---@param filename string 文件名 / File name
+---@return soluna.capture.reader
+function capture.reader(filename)
+end
+
+return capture
@@ -0,0 +1,44 @@
+---@meta soluna.image.bc
+
+---BC3 (DXT5) 纹理压缩模块，纹理集在 `atlas_compress : bc3` 时使用
+---BC3 (DXT5) texture compression module, used by the sprite atlas with `atlas_compress : bc3`.
+---@class soluna.image.bc
+local bc = {}
+
+---把 RGBA 图片压缩成 BC3 块，宽高不是 4 的倍数时复制边缘像素
+---Encodes RGBA pixels into BC3 blocks, edge pixels are repeated when the size isn't a multiple of 4.
+---@param data string|lightuserdata RGBA 像素数据 / RGBA pixels
+---@param width integer 宽度 / Width
+---@param height integer 高度 / Height
+---@return string blocks BC3 数据，每个 4x4 块 16 字节 / BC3 blocks, 16 bytes per 4x4 block
+function bc.encode(data, width, height)
+end
+
+---把 BC3 块解码成 RGBA 图片
+---Decodes BC3 blocks into RGBA pixels.
+---@param blocks string|lightuserdata BC3 数据 / BC3 blocks
+---@param width integer 宽度 / Width
+---@param height integer 高度 / Height
+---@return string data RGBA 像素数据 / RGBA pixels
+function bc.decode(blocks, width, height)
+end
+
+---计算两张 RGBA 图片的峰值信噪比
+---Peak signal-to-noise ratio of two RGBA images.
+---@param a string|lightuserdata RGBA 像素数据 / RGBA pixels
+---@param b string|lightuserdata RGBA 像素数据 / RGBA pixels
+---@param width integer 宽度 / Width
+---@param height integer 高度 / Height
+---@return number psnr 分贝，完全相同时为 inf / In dB, inf when they are the same
+function bc.psnr(a, b, width, height)
+end
+
+---BC3 数据的字节数
+---Size of BC3 blocks in bytes.
+---@param width integer 宽度 / Width
+---@param height integer 高度 / Height
+---@return integer size 字节数 / Bytes
+function bc.size(width, height)
+end
+
+return bc
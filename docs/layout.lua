@@ -46,22 +46,31 @@ end
 ---@field [integer] soluna.layout.Item 绘制条目 / Drawable item
 ---@field width number 根节点宽度 / Root width
 ---@field height number 根节点高度 / Root height
+---@field changed integer 本次计算中布局有变化的条目数，为 0 时可跳过重绘 / Number of items whose layout changed in this calculation; 0 means nothing moved
 
 ---Yoga layout 模块
 ---Yoga layout module.
 ---@class soluna.layout
 local layout = {}
 
----加载 layout 定义
----Loads a layout definition.
+---加载 layout 定义；文件也可以是 `layout.compile` 生成的二进制数据
+---Loads a layout definition; the file may also contain binary data produced by `layout.compile`.
 ---@param filename_or_list string|table layout 文件路径或已解析 datalist / Layout file path or parsed datalist
 ---@param scripts? fun(name: string): table children 动态 children resolver / Dynamic children resolver
 ---@return soluna.layout.Document document layout 文档 / Layout document
 function layout.load(filename_or_list, scripts)
 end
 
----计算 layout 并返回绘制条目
----Calculates layout and returns drawable items.
+---把 layout 定义编译为二进制数据，加载时不再解析属性字符串；动态 children 在编译时展开
+---Compiles a layout definition into binary data that loads without parsing attribute strings; dynamic children are resolved at compile time.
+---@param filename_or_list string|table layout 文件路径或已解析 datalist / Layout file path or parsed datalist
+---@param scripts? fun(name: string): table children 动态 children resolver / Dynamic children resolver
+---@return string data 二进制 layout 数据 / Binary layout data
+function layout.compile(filename_or_list, scripts)
+end
+
+---计算 layout 并返回绘制条目；只有布局变化的条目会被更新
+---Calculates layout and returns drawable items; only items whose layout changed are updated.
 ---@param document soluna.layout.Document layout 文档 / Layout document
 ---@return soluna.layout.Result items 绘制条目列表 / Drawable item list
 function layout.calc(document)
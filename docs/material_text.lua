@@ -1,8 +1,8 @@
 ---@meta soluna.material.text
 
----文本块创建函数
----Text block builder function.
----@alias soluna.material.text.Block fun(text: string, width?: integer, height?: integer): string, integer
+---文本块创建函数，`transient` 为 true 时结果放在帧内存中，只在下一帧结束前有效
+---Text block builder function. When `transient` is true, the result lives in the frame arena and is valid until the end of the next frame.
+---@alias soluna.material.text.Block fun(text: string, width?: integer, height?: integer, transient?: boolean): string, integer
 
 ---光标位置查询函数
 ---Text cursor query function.
@@ -27,6 +27,24 @@
 ---@field w integer 宽度 / Width
 ---@field h integer 高度 / Height
 
+---缓存层，内容渲染到离屏纹理，之后每帧只绘制一个 sprite
+---Cached layer. Its content is rendered into an offscreen texture, then drawn as one sprite in later frames.
+---@class soluna.Layer
+---@field id integer 显示该层的 sprite id，用于 `batch:add` / Sprite id showing the layer, for `batch:add`
+---@field handle integer 层句柄 / Layer handle
+local Layer = {}
+
+---更新层内容，在当前帧重新渲染；坐标以层左上角为原点。内容会被复制，之后可以重用 batch
+---Updates the content, it's rendered again in the current frame. Coordinates are relative to the top left of the layer. The content is copied, the batch can be reused after.
+---@param content userdata `soluna.spritemgr.newbatch()` 创建的 batch / A batch created by `soluna.spritemgr.newbatch()`
+function Layer:update(content)
+end
+
+---释放层及其渲染目标，之后不能再绘制 `id`
+---Releases the layer and its render target. Don't draw `id` after it.
+function Layer:release()
+end
+
 ---音频播放选项
 ---Audio playback options.
 ---@class soluna.AudioPlayOptions
@@ -97,6 +115,58 @@ end
 function AudioVoice:tell()
 end
 
+---音频命令批次：记录 voice 操作，`flush` 时一次性发送给音频服务，不等待回复
+---Audio command batch: records voice operations and sends them to the audio service in one message on `flush`, without waiting for a reply.
+---@class soluna.AudioBatch
+local AudioBatch = {}
+
+---设置 voice 音量
+---Queues a voice volume change.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param volume number 线性音量倍率 / Linear volume multiplier
+function AudioBatch:set_volume(voice, volume)
+end
+
+---设置 voice 声像
+---Queues a voice pan change.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param pan number 声像 / Stereo pan
+function AudioBatch:set_pan(voice, pan)
+end
+
+---设置 voice pitch
+---Queues a voice pitch change.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param pitch number pitch 倍率 / Pitch multiplier
+function AudioBatch:set_pitch(voice, pitch)
+end
+
+---设置 voice 是否循环
+---Queues a voice loop change.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param loop boolean 是否循环 / Whether to loop
+function AudioBatch:set_loop(voice, loop)
+end
+
+---跳转播放位置
+---Queues a seek.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param seconds number 目标秒数 / Target seconds
+function AudioBatch:seek(voice, seconds)
+end
+
+---停止播放
+---Queues a stop.
+---@param voice soluna.AudioVoice voice 句柄 / Voice handle
+---@param fade_seconds? number fade out 秒数 / Fade-out seconds
+function AudioBatch:stop(voice, fade_seconds)
+end
+
+---发送所有已记录的命令并清空批次；已失效的 voice 会被忽略
+---Sends all queued commands and clears the batch; commands for released voices are ignored.
+function AudioBatch:flush()
+end
+
 ---音频 bus 句柄
 ---Audio bus handle.
 ---@class soluna.AudioBus
@@ -157,6 +227,21 @@ end
 function soluna.load_sprites(filename)
 end
 
+---卸载 sprite bundle，文件 bundle 按加载次数引用计数。卸载后不可再使用其中的 sprite id
+---Unloads a sprite bundle. Bundles from file are reference counted by loads. Don't use its sprite ids after unloading.
+---纹理中空闲过多时会重新打包存活的 sprite，并释放空纹理 / Live sprites are repacked and empty textures are dropped when too much texture space is free
+---@param bundle string|SpriteBundle `.dl` 文件路径，或由表加载返回的 bundle / `.dl` path, or the bundle returned by loading a table
+function soluna.unload_sprites(bundle)
+end
+
+---创建缓存层，`w` 和 `h` 不能超过 `settings.texture_size`
+---Creates a cached layer, `w` and `h` should not be larger than `settings.texture_size`.
+---@param w integer 宽度 / Width
+---@param h integer 高度 / Height
+---@return soluna.Layer layer
+function soluna.layer(w, h)
+end
+
 ---预加载运行时生成的 RGBA sprite 图片
 ---Preloads runtime-generated RGBA sprite images.
 ---@param sprites soluna.PreloadSprite|soluna.PreloadSprite[] 单个 sprite 或列表 / One sprite or a list
@@ -178,6 +263,20 @@ end
 function soluna.play_sound(name, opts)
 end
 
+---创建音频命令批次，通常每帧 `flush` 一次
+---Creates an audio command batch, usually flushed once per frame.
+---@return soluna.AudioBatch batch 命令批次 / Command batch
+function soluna.audio_batch()
+end
+
+---一次查询多个 voice 的状态
+---Queries the state of many voices in one request.
+---@param voices soluna.AudioVoice[] voice 列表 / Voice list
+---@return boolean[] playing 是否播放中 / Whether each voice is playing
+---@return (number|false)[] seconds 当前秒数，voice 无效时为 false / Current seconds, false for invalid voices
+function soluna.voice_query(voices)
+end
+
 ---返回 audio bus 句柄
 ---Returns an audio bus handle.
 ---@param name string bus 名称 / Bus name
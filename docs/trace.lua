@@ -0,0 +1,44 @@
+---@meta soluna.trace
+
+---启动时间线追踪，记录 C 主线程和各个服务的时间戳
+---Startup timeline tracer, records timestamps from the C main thread and every service.
+---@class soluna.trace
+local trace = {}
+
+---标记一个阶段开始，开始和结束在同一个协程内配对
+---Marks the beginning of a phase; begin and finish are paired within the same coroutine.
+---@param name string 阶段名 / Phase name
+function trace.begin(name)
+end
+
+---标记一个阶段结束
+---Marks the end of a phase.
+---@param name string 阶段名 / Phase name
+function trace.finish(name)
+end
+
+---记录一个时间点
+---Records an instant.
+---@param name string 事件名 / Event name
+function trace.mark(name)
+end
+
+---设置当前服务在时间线中的名字
+---Sets the name of the current service in the timeline.
+---@param name string 服务名 / Service name
+function trace.name(name)
+end
+
+---返回文本格式的时间线，结束行带阶段耗时
+---Returns the timeline as text; end lines include the phase duration.
+---@return string report 时间线 / Timeline
+function trace.report()
+end
+
+---把时间线写成 Chrome trace JSON 文件
+---Writes the timeline as a Chrome trace JSON file.
+---@param filename string 文件名 / Filename
+function trace.write(filename)
+end
+
+return trace
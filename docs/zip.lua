@@ -13,4 +13,20 @@ local zip = {}
 function zip.open(filename, mode)
 end
 
+---压缩数据，输出首字节记录解压缓冲的倍数
+---Compresses data; the first byte of the output records the uncompress buffer ratio.
+---@param data string|lightuserdata 源数据 / Source data
+---@param size? integer data 为 lightuserdata 时的字节数 / Byte size when data is a lightuserdata
+---@param level? integer zlib 压缩级别 (0-9)，默认为 zlib 默认级别 / zlib level (0-9), zlib default when omitted
+---@return string compressed 压缩结果 / Compressed data
+function zip.compress(data, size, level)
+end
+
+---解压 zip.compress 的结果
+---Uncompresses the output of zip.compress.
+---@param data string 压缩数据 / Compressed data
+---@return string data 原始数据 / Original data
+function zip.uncompress(data)
+end
+
 return zip
@@ -5,6 +5,7 @@
 
 #include "materialapi.h"
 #include "perspective_quad.glsl.h"
+#include "tint_quad.glsl.h"
 
 LUA_API void luaapi_init(lua_State *L);
 void materialapi_init(lua_State *L);
@@ -42,6 +43,7 @@ struct pquad_inst {
 };
 
 static int material_id = 0;
+static int tint_material_id = 0;
 
 static void
 set_position_homography(const float pos[PQUAD_CORNER_N][2], struct pquad_inst *inst) {
@@ -80,12 +82,10 @@ set_position_homography(const float pos[PQUAD_CORNER_N][2], struct pquad_inst *i
 	inst->pos_h2[2] = 1.0f;
 }
 
+// 0xaarrggbb, alpha 0 means opaque
 static struct color
-get_color(lua_State *L, int index) {
-	uint32_t color;
+make_color(uint32_t color) {
 	struct color c;
-	lua_getfield(L, index, "color");
-	color = (uint32_t)luaL_optinteger(L, -1, 0xffffffff);
 	if (!(color & 0xff000000)) {
 		color |= 0xff000000;
 	}
@@ -93,6 +93,13 @@ get_color(lua_State *L, int index) {
 	c.channel[1] = (color >> 8) & 0xff;
 	c.channel[2] = color & 0xff;
 	c.channel[3] = (color >> 24) & 0xff;
+	return c;
+}
+
+static struct color
+get_color(lua_State *L, int index) {
+	lua_getfield(L, index, "color");
+	struct color c = make_color((uint32_t)luaL_optinteger(L, -1, 0xffffffff));
 	lua_pop(L, 1);
 	return c;
 }
@@ -144,6 +151,19 @@ submit_perspective_quad(const struct material_item *item, void *out) {
 	return NULL;
 }
 
+static material_error
+submit_perspective_quads(const struct material_item *items, int n, void *out) {
+	struct pquad_inst *inst = (struct pquad_inst *)out;
+	int i;
+	for (i = 0; i < n; i++) {
+		material_error err = submit_perspective_quad(&items[i], &inst[i]);
+		if (err != NULL) {
+			return err;
+		}
+	}
+	return NULL;
+}
+
 static void
 pipeline_perspective_quad(sg_pipeline_desc *desc) {
 	desc->layout.attrs[ATTR_perspective_quad_pos_h0].format = SG_VERTEXFORMAT_FLOAT3;
@@ -158,7 +178,7 @@ pipeline_perspective_quad(sg_pipeline_desc *desc) {
 static const struct material_hook perspective_quad_hooks[] = {
 	{ "shader", { .shader = perspective_quad_shader_desc } },
 	{ "pipeline", { .pipeline = pipeline_perspective_quad } },
-	{ "submit", { .submit = submit_perspective_quad } },
+	{ "submit_many", { .submit_many = submit_perspective_quads } },
 	{ NULL, { NULL } },
 };
 
@@ -209,6 +229,117 @@ luaopen_ext_material_perspective_quad(lua_State *L) {
 	return 1;
 }
 
+// A sprite quad tinted by a per item uniform, the uniforms are in the item buffer of the material
+
+struct tint_payload {
+	struct color color;
+	int reserved[2];
+};
+
+typedef char tint_payload_size_check[sizeof(struct tint_payload) == MATERIAL_DATA_SIZE ? 1 : -1];
+
+struct tint_inst {
+	float position[3];
+	float uv_rect[4];
+	float offset[2];
+};
+
+// struct tint_item in tint_quad.glsl
+struct tint_item {
+	float color[4];
+};
+
+static material_error
+submit_tint_quad(const struct material_item *item, void *out) {
+	if (item->sprite < 0) {
+		return "Tint quad needs a sprite";
+	}
+	struct tint_inst *inst = (struct tint_inst *)out;
+	inst->position[0] = item->x;
+	inst->position[1] = item->y;
+	inst->position[2] = (float)item->transform_index;
+	inst->uv_rect[0] = item->rect.u;
+	inst->uv_rect[1] = item->rect.v;
+	inst->uv_rect[2] = item->rect.w;
+	inst->uv_rect[3] = item->rect.h;
+	inst->offset[0] = item->rect.ox;
+	inst->offset[1] = item->rect.oy;
+	return NULL;
+}
+
+static material_error
+uniform_tint_quad(const struct material_item *item, void *out) {
+	const struct tint_payload *payload = (const struct tint_payload *)item->data;
+	struct tint_item *u = (struct tint_item *)out;
+	int i;
+	for (i = 0; i < 4; i++) {
+		u->color[i] = payload->color.channel[i] / 255.0f;
+	}
+	return NULL;
+}
+
+static void
+pipeline_tint_quad(sg_pipeline_desc *desc) {
+	desc->layout.attrs[ATTR_tint_quad_position].format = SG_VERTEXFORMAT_FLOAT3;
+	desc->layout.attrs[ATTR_tint_quad_uv_rect].format = SG_VERTEXFORMAT_FLOAT4;
+	desc->layout.attrs[ATTR_tint_quad_offset].format = SG_VERTEXFORMAT_FLOAT2;
+}
+
+static const struct material_hook tint_quad_hooks[] = {
+	{ "shader", { .shader = tint_quad_shader_desc } },
+	{ "pipeline", { .pipeline = pipeline_tint_quad } },
+	{ "submit", { .submit = submit_tint_quad } },
+	{ "uniform", { .uniform = uniform_tint_quad } },
+	{ NULL, { NULL } },
+};
+
+static int
+lset_tint_material_id(lua_State *L) {
+	int id = luaL_checkinteger(L, 1);
+	if (id <= 0) {
+		return luaL_error(L, "Invalid tint quad material id %d", id);
+	}
+	tint_material_id = id;
+	return 0;
+}
+
+static int
+ltint_quad_sprite(lua_State *L) {
+	if (tint_material_id <= 0) {
+		return luaL_error(L, "Tint quad material is not registered");
+	}
+	struct tint_payload payload;
+	memset(&payload, 0, sizeof(payload));
+	payload.color = make_color((uint32_t)luaL_optinteger(L, 2, 0xffffffff));
+	int sprite = luaL_checkinteger(L, 1) - 1;
+	struct material_push_item item = {
+		.sprite = sprite,
+		.data = &payload,
+	};
+	return material_push(L, tint_material_id, &item);
+}
+
+static int
+luaopen_ext_material_tint_quad(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "set_material_id", lset_tint_material_id },
+		{ "sprite", ltint_quad_sprite },
+		{ "instance_size", NULL },
+		{ "item_size", NULL },
+		{ "hooks", NULL },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	lua_pushinteger(L, sizeof(struct tint_inst));
+	lua_setfield(L, -2, "instance_size");
+	lua_pushinteger(L, sizeof(struct tint_item));
+	lua_setfield(L, -2, "item_size");
+	material_push_hooks(L, tint_quad_hooks);
+	lua_setfield(L, -2, "hooks");
+	return 1;
+}
+
 static int
 lhello(lua_State *L) {
 	lua_pushstring(L, "Hello World From Sample");
@@ -232,6 +363,7 @@ extlua_init(lua_State *L) {
 	luaL_Reg l[] = {
 		{ "ext.foobar", luaopen_foobar },
 		{ "ext.material.perspective_quad", luaopen_ext_material_perspective_quad },
+		{ "ext.material.tint_quad", luaopen_ext_material_tint_quad },
 		{ NULL, NULL },
 	};
 	luaL_newlib(L, l);
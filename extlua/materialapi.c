@@ -49,7 +49,8 @@ struct extlua_apis {
 void
 materialapi_init(lua_State *L) {
 	struct extlua_apis *apis = *(struct extlua_apis **)lua_getextraspace(L);
-	if (apis == NULL || apis->material == NULL || apis->material->version != MATERIAL_API_VERSION) {
+	// the host keeps the api of older versions, a module works with the same or newer host
+	if (apis == NULL || apis->material == NULL || apis->material->version < MATERIAL_API_VERSION) {
 		int version = (apis != NULL && apis->material != NULL) ? apis->material->version : 0;
 		luaL_error(L, "material api version mismatch, expected %d got %d", MATERIAL_API_VERSION, version);
 	}
@@ -7,7 +7,7 @@
 
 #include "sokol/sokol_gfx.h"
 
-#define MATERIAL_API_VERSION 1
+#define MATERIAL_API_VERSION 2
 #define MATERIAL_DATA_SIZE 12
 
 typedef const char *material_error;
@@ -45,6 +45,8 @@ typedef const sg_shader_desc *(*material_shader_desc_func)(sg_backend backend);
 typedef void (*material_pipeline_desc_func)(sg_pipeline_desc *desc);
 typedef material_error (*material_submit_one_func)(const struct material_item *item, void *instance);
 typedef material_error (*material_uniform_one_func)(const struct material_item *item, void *uniform);
+// since version 2, optional hook "submit_many" : items[n] -> instances[n], instances are zeroed and packed by instance_size
+typedef material_error (*material_submit_many_func)(const struct material_item *items, int n, void *instances);
 
 union material_hook_func {
 	void *ptr;
@@ -52,6 +54,7 @@ union material_hook_func {
 	material_pipeline_desc_func pipeline;
 	material_submit_one_func submit;
 	material_uniform_one_func uniform;
+	material_submit_many_func submit_many;
 };
 
 struct material_hook {
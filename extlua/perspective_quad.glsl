@@ -37,7 +37,8 @@ void main() {
 	float qv = max(mix(qx0, qx1, corner.y), 1e-6);
 	uvq = vec3(uv * qv, qv);
 	vec2 clip = pos * framesize;
-	gl_Position = vec4(clip.x - 1.0, clip.y + 1.0, 0.0, 1.0);
+	// framesize.y is positive in the layers of GL, see render.lua
+	gl_Position = vec4(clip.x - 1.0, clip.y - sign(framesize.y), 0.0, 1.0);
 	frag_color = color;
 	tex_scale = texsize;
 }
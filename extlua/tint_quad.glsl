@@ -0,0 +1,61 @@
+@module tint
+
+@vs vs
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+	float texsize;
+};
+
+// the index of the first item of this draw, see material_external.c struct item_base
+layout(binding=1) uniform vs_item {
+	int base;
+};
+
+struct sr_mat {
+	mat2 m;
+};
+
+layout(binding=0) readonly buffer sr_lut {
+	sr_mat sr[];
+};
+
+// per item uniforms in the item buffer of the material
+struct tint_item {
+	vec4 color;
+};
+
+layout(binding=2) readonly buffer tint_items {
+	tint_item items[];
+};
+
+in vec3 position;
+in vec4 uv_rect;
+in vec2 offset;
+
+out vec2 uv;
+out vec4 tint;
+
+void main() {
+	vec2 corner = vec2(float(gl_VertexIndex & 1), float(gl_VertexIndex >> 1));
+	vec2 uv_offset = uv_rect.zw * corner;
+	vec2 pos = ((uv_offset - offset) * sr[int(position.z)].m + position.xy) * framesize;
+	gl_Position = vec4(pos.x - 1.0, pos.y - sign(framesize.y), 0.0, 1.0);
+	uv = (uv_rect.xy + uv_offset) * texsize;
+	tint = items[base + gl_InstanceIndex].color;
+}
+@end
+
+@fs fs
+layout(binding=1) uniform texture2D tex;
+layout(binding=0) uniform sampler smp;
+
+in vec2 uv;
+in vec4 tint;
+out vec4 frag_color;
+
+void main() {
+	frag_color = texture(sampler2D(tex, smp), uv) * tint;
+}
+@end
+
+@program quad vs fs
@@ -1,7 +1,8 @@
-local luasrc, cname = ...
+local luasrc, cname, mode = ...
 
+-- mode "strip" : drop debug information (line numbers, local names) from the bytecode
 local s = assert(loadfile(luasrc))
-local bin = string.dump(s)
+local bin = string.dump(s, mode == "strip")
 
 local code = [[
 static const unsigned char luasrc_$name[] = {
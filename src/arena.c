@@ -0,0 +1,198 @@
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ALIGN_SIZE(sz) (((sz) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Transient memory for one frame, double buffered :
+// the game services fill one half in frame N while the other half (frame N-1) is dropped,
+// so anything handed to the render service (or kept by the game) lives until the end of frame N+1.
+// When a half is exhausted, allocations fall back to malloc and the half grows at the next reuse,
+// so the memory used in steady state is two halves of the peak frame.
+
+struct overflow_block {
+	struct overflow_block *next;
+};
+
+#define BLOCK_HEADER ALIGN_SIZE(sizeof(struct overflow_block))
+
+struct arena_half {
+	char *ptr;
+	size_t cap;
+	atomic_size_t offset;
+	atomic_int count;
+	atomic_int overflow;
+	_Atomic(struct overflow_block *) list;
+};
+
+static struct {
+	struct arena_half half[2];
+	atomic_int current;
+	struct frame_arena_stat stat;
+} ARENA;
+
+static void
+half_reserve(struct arena_half *h, size_t size) {
+	if (size > h->cap) {
+		size_t cap = h->cap ? h->cap : ARENA_ALIGN;
+		while (cap < size)
+			cap *= 2;
+		char *ptr = (char *)malloc(cap);
+		if (ptr) {
+			free(h->ptr);
+			h->ptr = ptr;
+			h->cap = cap;
+		}
+	}
+}
+
+static void
+half_reset(struct arena_half *h, size_t expect) {
+	struct overflow_block *b = atomic_exchange(&h->list, NULL);
+	while (b) {
+		struct overflow_block *next = b->next;
+		free(b);
+		b = next;
+	}
+	half_reserve(h, expect);
+	atomic_store(&h->offset, 0);
+	atomic_store(&h->count, 0);
+	atomic_store(&h->overflow, 0);
+}
+
+void
+frame_arena_init(size_t size) {
+	size = ALIGN_SIZE(size);
+	half_reserve(&ARENA.half[0], size);
+	half_reserve(&ARENA.half[1], size);
+	ARENA.stat.capacity = ARENA.half[0].cap + ARENA.half[1].cap;
+}
+
+void *
+frame_arena_alloc(size_t sz) {
+	sz = ALIGN_SIZE(sz);
+	struct arena_half *h = &ARENA.half[atomic_load_explicit(&ARENA.current, memory_order_acquire)];
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	size_t offset = atomic_fetch_add_explicit(&h->offset, sz, memory_order_relaxed);
+	if (offset + sz <= h->cap)
+		return h->ptr + offset;
+	struct overflow_block *b = (struct overflow_block *)malloc(BLOCK_HEADER + sz);
+	if (b == NULL)
+		return NULL;
+	atomic_fetch_add_explicit(&h->overflow, 1, memory_order_relaxed);
+	b->next = atomic_load_explicit(&h->list, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak(&h->list, &b->next, b)) {}
+	return (char *)b + BLOCK_HEADER;
+}
+
+void
+frame_arena_swap(void) {
+	int current = atomic_load(&ARENA.current);
+	struct arena_half *h = &ARENA.half[current];
+	struct frame_arena_stat *stat = &ARENA.stat;
+	size_t bytes = atomic_load(&h->offset);
+	stat->bytes = bytes;
+	stat->count = atomic_load(&h->count);
+	stat->overflow = atomic_load(&h->overflow);
+	if (bytes > stat->peak)
+		stat->peak = bytes;
+	// The other half was used in the previous frame, nobody refers to it now.
+	struct arena_half *next = &ARENA.half[!current];
+	size_t expect = atomic_load(&next->offset);
+	if (bytes > expect)
+		expect = bytes;
+	half_reset(next, expect);
+	stat->capacity = ARENA.half[0].cap + ARENA.half[1].cap;
+	atomic_store_explicit(&ARENA.current, !current, memory_order_release);
+}
+
+void
+frame_arena_stat(struct frame_arena_stat *stat) {
+	*stat = ARENA.stat;
+}
+
+static void *
+arena_nofree(void *ud, void *ptr, size_t osize, size_t nsize) {
+	return NULL;
+}
+
+void
+frame_arena_pushstring(lua_State *L, void *ptr, size_t sz) {
+	lua_pushexternalstring(L, (const char *)ptr, sz, arena_nofree, NULL);
+}
+
+static int
+larena_init(lua_State *L) {
+	size_t size = (size_t)luaL_checkinteger(L, 1);
+	frame_arena_init(size);
+	return 0;
+}
+
+static int
+larena_swap(lua_State *L) {
+	frame_arena_swap();
+	return 0;
+}
+
+static int
+larena_alloc(lua_State *L) {
+	lua_Integer sz = luaL_checkinteger(L, 1);
+	if (sz <= 0)
+		return luaL_error(L, "Invalid arena size %d", (int)sz);
+	void *ptr = frame_arena_alloc((size_t)sz);
+	if (ptr == NULL)
+		return luaL_error(L, "Frame arena : Out of memory");
+	lua_pushlightuserdata(L, ptr);
+	return 1;
+}
+
+static int
+larena_string(lua_State *L) {
+	size_t sz;
+	const char *str = luaL_checklstring(L, 1, &sz);
+	char *ptr = (char *)frame_arena_alloc(sz + 1);
+	if (ptr == NULL)
+		return luaL_error(L, "Frame arena : Out of memory");
+	memcpy(ptr, str, sz + 1);
+	frame_arena_pushstring(L, ptr, sz);
+	lua_pushlightuserdata(L, ptr);
+	return 2;
+}
+
+static int
+larena_stat(lua_State *L) {
+	struct frame_arena_stat stat;
+	frame_arena_stat(&stat);
+	lua_createtable(L, 0, 5);
+	lua_pushinteger(L, stat.bytes);
+	lua_setfield(L, -2, "bytes");
+	lua_pushinteger(L, stat.count);
+	lua_setfield(L, -2, "count");
+	lua_pushinteger(L, stat.overflow);
+	lua_setfield(L, -2, "overflow");
+	lua_pushinteger(L, stat.peak);
+	lua_setfield(L, -2, "peak");
+	lua_pushinteger(L, stat.capacity);
+	lua_setfield(L, -2, "capacity");
+	return 1;
+}
+
+int
+luaopen_soluna_arena(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", larena_init },
+		{ "swap", larena_swap },
+		{ "alloc", larena_alloc },
+		{ "string", larena_string },
+		{ "stat", larena_stat },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
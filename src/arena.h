@@ -0,0 +1,27 @@
+#ifndef soluna_arena_h
+#define soluna_arena_h
+
+#include <stddef.h>
+#include <lua.h>
+
+// Frame arena, see arena.c
+// Memory allocated in frame N is valid until the end of frame N+1, never free it.
+
+struct frame_arena_stat {
+	size_t bytes;		// bytes allocated in the last frame
+	size_t peak;		// max bytes allocated in one frame
+	size_t capacity;	// bytes reserved by both halves
+	int count;		// allocations in the last frame
+	int overflow;		// allocations out of the reserved memory in the last frame
+};
+
+void frame_arena_init(size_t size);
+// 16 bytes aligned, thread safe. returns NULL when out of memory
+void * frame_arena_alloc(size_t sz);
+// Only call it when no one allocates : render service calls it at the end of each frame
+void frame_arena_swap(void);
+void frame_arena_stat(struct frame_arena_stat *stat);
+// push ptr[0, sz) as an external string, ptr[sz] must be 0
+void frame_arena_pushstring(lua_State *L, void *ptr, size_t sz);
+
+#endif
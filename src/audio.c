@@ -1,5 +1,7 @@
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "zipreader.h"
 
@@ -70,6 +72,7 @@ struct audio_sound {
 
 #define AUDIO_GROUP_METATABLE "SOLUNA_AUDIO_GROUP"
 #define AUDIO_SOUND_METATABLE "SOLUNA_AUDIO_SOUND"
+#define AUDIO_SAMPLE_METATABLE "SOLUNA_AUDIO_SAMPLE"
 
 static struct custom_engine *
 check_engine(lua_State *L, int index) {
@@ -91,6 +94,13 @@ check_sound(lua_State *L, int index) {
 	return sound;
 }
 
+static struct audio_sound *
+check_sample(lua_State *L, int index) {
+	struct audio_sound *sample = (struct audio_sound *)luaL_checkudata(L, index, AUDIO_SAMPLE_METATABLE);
+	luaL_argcheck(L, sample->alive, index, "closed audio sample");
+	return sample;
+}
+
 static int
 push_error(lua_State *L, ma_result r) {
 	lua_pushnil(L);
@@ -118,6 +128,16 @@ laudio_sound_uninit(lua_State *L) {
 	return 0;
 }
 
+static int
+laudio_sample_uninit(lua_State *L) {
+	struct audio_sound *sample = (struct audio_sound *)luaL_checkudata(L, 1, AUDIO_SAMPLE_METATABLE);
+	if (sample->alive) {
+		ma_sound_uninit(&sample->sound);
+		sample->alive = 0;
+	}
+	return 0;
+}
+
 static ma_result
 zr_open(ma_vfs* pVFS, const char* pFilePath, ma_uint32 openMode, ma_vfs_file* pFile) {
 	struct custom_vfs *vfs = (struct custom_vfs *)pVFS;
@@ -289,6 +309,57 @@ laudio_sound_init(lua_State *L) {
 	return 1;
 }
 
+// A sample is a never played sound fully decoded by the resource manager.
+// The decoded PCM is kept alive as long as the sample (or any copy of it) exists,
+// so sound_copy() doesn't touch the file system or the decoder again.
+static int
+laudio_sample_init(lua_State *L) {
+	struct custom_engine *e = check_engine(L, 1);
+	const char *filename = luaL_checkstring(L, 2);
+	struct audio_sound *sample = (struct audio_sound *)lua_newuserdatauv(L, sizeof(*sample), 0);
+	sample->alive = 0;
+	ma_result r = ma_sound_init_from_file(&e->engine, filename, MA_SOUND_FLAG_DECODE, NULL, NULL, &sample->sound);
+	if (r != MA_SUCCESS) {
+		lua_pop(L, 1);
+		return push_error(L, r);
+	}
+	sample->alive = 1;
+	luaL_setmetatable(L, AUDIO_SAMPLE_METATABLE);
+	return 1;
+}
+
+static int
+laudio_sound_copy(lua_State *L) {
+	struct custom_engine *e = check_engine(L, 1);
+	struct audio_sound *sample = check_sample(L, 2);
+	struct audio_group *group = NULL;
+	if (!lua_isnoneornil(L, 3)) {
+		group = check_group(L, 3);
+	}
+	struct audio_sound *sound = (struct audio_sound *)lua_newuserdatauv(L, sizeof(*sound), 0);
+	sound->alive = 0;
+	ma_result r = ma_sound_init_copy(&e->engine, &sample->sound, 0, group ? &group->group : NULL, &sound->sound);
+	if (r != MA_SUCCESS) {
+		lua_pop(L, 1);
+		return push_error(L, r);
+	}
+	sound->alive = 1;
+	luaL_setmetatable(L, AUDIO_SOUND_METATABLE);
+	return 1;
+}
+
+// Stop the sound and clear the fade / stop time left by sound_stop, so it can be started again from a pool.
+static int
+laudio_sound_reset(lua_State *L) {
+	struct audio_sound *sound = check_sound(L, 1);
+	ma_sound *s = &sound->sound;
+	ma_sound_stop(s);
+	ma_sound_set_stop_time_in_pcm_frames(s, ~(ma_uint64)0);
+	ma_sound_set_fade_in_pcm_frames(s, -1, 1, 0);
+	ma_sound_seek_to_pcm_frame(s, 0);
+	return 0;
+}
+
 static int
 laudio_sound_start(lua_State *L) {
 	struct audio_sound *sound = check_sound(L, 1);
@@ -384,6 +455,106 @@ laudio_sound_tell(lua_State *L) {
 	return 1;
 }
 
+// Keep in sync with AUDIO_OP_* in lualib/soluna.lua
+#define AUDIO_OP_VOLUME 1
+#define AUDIO_OP_PAN 2
+#define AUDIO_OP_PITCH 3
+#define AUDIO_OP_LOOP 4
+#define AUDIO_OP_SEEK 5
+#define AUDIO_OP_STOP 6
+
+struct audio_command {
+	uint32_t id;
+	uint32_t op;
+	float value;
+};
+
+// 1: voices table (id -> sound), 2: string of packed audio_command ("<I4I4f")
+// Commands for missing or closed voices are ignored.
+static int
+laudio_sound_commands(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	size_t sz;
+	const char *buf = luaL_checklstring(L, 2, &sz);
+	if (sz % sizeof(struct audio_command) != 0)
+		return luaL_error(L, "Invalid audio command buffer size %d", (int)sz);
+	int n = sz / sizeof(struct audio_command);
+	int applied = 0;
+	int i;
+	for (i=0;i<n;i++) {
+		struct audio_command cmd;
+		memcpy(&cmd, buf + i * sizeof(cmd), sizeof(cmd));
+		lua_rawgeti(L, 1, cmd.id);
+		struct audio_sound *sound = (struct audio_sound *)luaL_testudata(L, -1, AUDIO_SOUND_METATABLE);
+		lua_pop(L, 1);
+		if (sound == NULL || !sound->alive)
+			continue;
+		ma_sound *s = &sound->sound;
+		switch (cmd.op) {
+		case AUDIO_OP_VOLUME:
+			ma_sound_set_volume(s, cmd.value);
+			break;
+		case AUDIO_OP_PAN:
+			ma_sound_set_pan(s, cmd.value);
+			break;
+		case AUDIO_OP_PITCH:
+			ma_sound_set_pitch(s, cmd.value);
+			break;
+		case AUDIO_OP_LOOP:
+			ma_sound_set_looping(s, cmd.value != 0.0f);
+			break;
+		case AUDIO_OP_SEEK:
+			ma_sound_seek_to_second(s, cmd.value);
+			break;
+		case AUDIO_OP_STOP:
+			if (cmd.value > 0.0f)
+				ma_sound_stop_with_fade_in_milliseconds(s, (ma_uint64)(cmd.value * 1000.0f + 0.5f));
+			else
+				ma_sound_stop(s);
+			break;
+		default:
+			return luaL_error(L, "Invalid audio command %d", (int)cmd.op);
+		}
+		++applied;
+	}
+	lua_pushinteger(L, applied);
+	return 1;
+}
+
+// 1: voices table, 2: ids array
+// returns playing array (boolean) and position array (seconds, false for missing voices)
+static int
+laudio_sound_query(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int n = lua_rawlen(L, 2);
+	lua_createtable(L, n, 0);
+	lua_createtable(L, n, 0);
+	int i;
+	for (i=1;i<=n;i++) {
+		lua_rawgeti(L, 2, i);
+		lua_rawget(L, 1);
+		struct audio_sound *sound = (struct audio_sound *)luaL_testudata(L, -1, AUDIO_SOUND_METATABLE);
+		lua_pop(L, 1);
+		if (sound == NULL || !sound->alive) {
+			lua_pushboolean(L, 0);
+			lua_rawseti(L, -3, i);
+			lua_pushboolean(L, 0);
+			lua_rawseti(L, -2, i);
+			continue;
+		}
+		lua_pushboolean(L, ma_sound_is_playing(&sound->sound));
+		lua_rawseti(L, -3, i);
+		float seconds = 0.0f;
+		if (ma_sound_get_cursor_in_seconds(&sound->sound, &seconds) == MA_SUCCESS)
+			lua_pushnumber(L, seconds);
+		else
+			lua_pushboolean(L, 0);
+		lua_rawseti(L, -2, i);
+	}
+	return 2;
+}
+
 int
 luaopen_soluna_audio(lua_State *L) {
 	luaL_checkversion(L);
@@ -397,6 +568,11 @@ luaopen_soluna_audio(lua_State *L) {
 		lua_setfield(L, -2, "__gc");
 	}
 	lua_pop(L, 1);
+	if (luaL_newmetatable(L, AUDIO_SAMPLE_METATABLE)) {
+		lua_pushcfunction(L, laudio_sample_uninit);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_pop(L, 1);
 	luaL_Reg l[] = {
 		{ "init", laudio_init },
 		{ "init_vfs", laudio_init_vfs },
@@ -406,6 +582,10 @@ luaopen_soluna_audio(lua_State *L) {
 		{ "group_set_volume", laudio_group_set_volume },
 		{ "sound_init", laudio_sound_init },
 		{ "sound_uninit", laudio_sound_uninit },
+		{ "sample_init", laudio_sample_init },
+		{ "sample_uninit", laudio_sample_uninit },
+		{ "sound_copy", laudio_sound_copy },
+		{ "sound_reset", laudio_sound_reset },
 		{ "sound_start", laudio_sound_start },
 		{ "sound_stop", laudio_sound_stop },
 		{ "sound_playing", laudio_sound_playing },
@@ -415,6 +595,8 @@ luaopen_soluna_audio(lua_State *L) {
 		{ "sound_set_looping", laudio_sound_set_looping },
 		{ "sound_seek", laudio_sound_seek },
 		{ "sound_tell", laudio_sound_tell },
+		{ "sound_commands", laudio_sound_commands },
+		{ "sound_query", laudio_sound_query },
 		{ NULL, NULL },
 	};
 	luaL_newlib(L, l);
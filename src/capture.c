@@ -0,0 +1,305 @@
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "batch.h"
+
+// Frame capture file :
+//	header : magic (8 bytes), version (uint32), materials (uint32 size + string)
+//	frame : stream number (uint32), each stream : primitive number (uint32), padding to 16 bytes, draw_primitive[]
+//	end : CAPTURE_END (uint32), texture_n (uint32), rects (uint32 size + bytes) , the sprite bank at the end of capture
+// All integers are native endian, the file is for replay on the same platform.
+
+#define CAPTURE_MAGIC "SOLUNACP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_END 0xffffffff
+#define CAPTURE_ALIGN 16
+
+struct capture_writer {
+	FILE *f;
+	long offset;
+};
+
+struct capture_reader {
+	uint8_t *data;
+	size_t size;
+	int frame_n;
+	uint32_t texture_n;
+	size_t rects;
+	size_t rects_size;
+	size_t materials;
+	size_t materials_size;
+	size_t *frame;
+};
+
+static void
+write_data(struct capture_writer *w, const void *data, size_t sz) {
+	fwrite(data, 1, sz, w->f);
+	w->offset += sz;
+}
+
+static void
+write_uint(struct capture_writer *w, uint32_t v) {
+	write_data(w, &v, sizeof(v));
+}
+
+static void
+write_padding(struct capture_writer *w) {
+	static const char zero[CAPTURE_ALIGN] = { 0 };
+	int pad = (CAPTURE_ALIGN - w->offset % CAPTURE_ALIGN) % CAPTURE_ALIGN;
+	write_data(w, zero, pad);
+}
+
+static struct capture_writer *
+check_writer(lua_State *L) {
+	struct capture_writer *w = (struct capture_writer *)luaL_checkudata(L, 1, "SOLUNA_CAPTURE_WRITER");
+	if (w->f == NULL)
+		luaL_error(L, "Capture file closed");
+	return w;
+}
+
+// 2: streams { ptr1, n1, ptr2, n2, ... }, 3: stream number
+static int
+lwriter_frame(lua_State *L) {
+	struct capture_writer *w = check_writer(L);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int n = luaL_checkinteger(L, 3);
+	write_uint(w, n);
+	int i;
+	for (i=0;i<n;i++) {
+		lua_rawgeti(L, 2, i*2+1);
+		lua_rawgeti(L, 2, i*2+2);
+		const void *ptr = lua_touserdata(L, -2);
+		int prim_n = luaL_checkinteger(L, -1);
+		lua_pop(L, 2);
+		if (ptr == NULL)
+			prim_n = 0;
+		write_uint(w, prim_n);
+		write_padding(w);
+		write_data(w, ptr, prim_n * sizeof(struct draw_primitive));
+	}
+	return 0;
+}
+
+// 2: rects, 3: texture_n (from sprite bank:dump())
+static int
+lwriter_close(lua_State *L) {
+	struct capture_writer *w = check_writer(L);
+	size_t sz;
+	const char *rects = luaL_checklstring(L, 2, &sz);
+	uint32_t texture_n = luaL_checkinteger(L, 3);
+	write_uint(w, CAPTURE_END);
+	write_uint(w, texture_n);
+	write_uint(w, sz);
+	write_data(w, rects, sz);
+	fclose(w->f);
+	w->f = NULL;
+	return 0;
+}
+
+static int
+lwriter_gc(lua_State *L) {
+	struct capture_writer *w = (struct capture_writer *)lua_touserdata(L, 1);
+	if (w->f) {
+		fclose(w->f);
+		w->f = NULL;
+	}
+	return 0;
+}
+
+// 1: filename, 2: material names
+static int
+lcapture_writer(lua_State *L) {
+	const char *filename = luaL_checkstring(L, 1);
+	size_t sz;
+	const char *materials = luaL_checklstring(L, 2, &sz);
+	struct capture_writer *w = (struct capture_writer *)lua_newuserdatauv(L, sizeof(*w), 0);
+	w->f = NULL;
+	w->offset = 0;
+	if (luaL_newmetatable(L, "SOLUNA_CAPTURE_WRITER")) {
+		luaL_Reg l[] = {
+			{ "__index", NULL },
+			{ "__gc", lwriter_gc },
+			{ "frame", lwriter_frame },
+			{ "close", lwriter_close },
+			{ NULL, NULL },
+		};
+		luaL_setfuncs(L, l, 0);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -2, "__index");
+	}
+	lua_setmetatable(L, -2);
+	w->f = fopen(filename, "wb");
+	if (w->f == NULL)
+		return luaL_error(L, "Can't open %s", filename);
+	write_data(w, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1);
+	write_uint(w, CAPTURE_VERSION);
+	write_uint(w, sz);
+	write_data(w, materials, sz);
+	return 1;
+}
+
+static int
+lreader_len(lua_State *L) {
+	struct capture_reader *r = (struct capture_reader *)luaL_checkudata(L, 1, "SOLUNA_CAPTURE_READER");
+	lua_pushinteger(L, r->frame_n);
+	return 1;
+}
+
+static uint32_t
+get_uint(struct capture_reader *r, size_t *offset) {
+	uint32_t v;
+	memcpy(&v, r->data + *offset, sizeof(v));
+	*offset += sizeof(v);
+	return v;
+}
+
+// 2: frame index (1-based), 3: streams table to fill { ptr1, n1, ... }
+// returns stream number, the pointers are valid as long as the reader is alive
+static int
+lreader_frame(lua_State *L) {
+	struct capture_reader *r = (struct capture_reader *)luaL_checkudata(L, 1, "SOLUNA_CAPTURE_READER");
+	int idx = luaL_checkinteger(L, 2) - 1;
+	luaL_checktype(L, 3, LUA_TTABLE);
+	if (idx < 0 || idx >= r->frame_n)
+		return luaL_error(L, "Invalid frame %d", idx + 1);
+	size_t offset = r->frame[idx];
+	int n = get_uint(r, &offset);
+	int i;
+	for (i=0;i<n;i++) {
+		uint32_t prim_n = get_uint(r, &offset);
+		offset = (offset + CAPTURE_ALIGN - 1) / CAPTURE_ALIGN * CAPTURE_ALIGN;
+		lua_pushlightuserdata(L, r->data + offset);
+		lua_rawseti(L, 3, i*2+1);
+		lua_pushinteger(L, prim_n);
+		lua_rawseti(L, 3, i*2+2);
+		offset += prim_n * sizeof(struct draw_primitive);
+	}
+	lua_pushinteger(L, n);
+	return 1;
+}
+
+// returns material names, rects, texture_n
+static int
+lreader_header(lua_State *L) {
+	struct capture_reader *r = (struct capture_reader *)luaL_checkudata(L, 1, "SOLUNA_CAPTURE_READER");
+	lua_pushlstring(L, (const char *)r->data + r->materials, r->materials_size);
+	lua_pushlstring(L, (const char *)r->data + r->rects, r->rects_size);
+	lua_pushinteger(L, r->texture_n);
+	return 3;
+}
+
+static int
+lreader_gc(lua_State *L) {
+	struct capture_reader *r = (struct capture_reader *)lua_touserdata(L, 1);
+	free(r->data);
+	r->data = NULL;
+	free(r->frame);
+	r->frame = NULL;
+	return 0;
+}
+
+static int
+invalid_capture(lua_State *L, const char *filename) {
+	return luaL_error(L, "Invalid or truncated capture file %s", filename);
+}
+
+static int
+check_range(struct capture_reader *r, size_t offset, size_t sz) {
+	return offset <= r->size && sz <= r->size - offset;
+}
+
+static int
+lcapture_reader(lua_State *L) {
+	const char *filename = luaL_checkstring(L, 1);
+	struct capture_reader *r = (struct capture_reader *)lua_newuserdatauv(L, sizeof(*r), 0);
+	memset(r, 0, sizeof(*r));
+	if (luaL_newmetatable(L, "SOLUNA_CAPTURE_READER")) {
+		luaL_Reg l[] = {
+			{ "__index", NULL },
+			{ "__gc", lreader_gc },
+			{ "__len", lreader_len },
+			{ "frame", lreader_frame },
+			{ "header", lreader_header },
+			{ NULL, NULL },
+		};
+		luaL_setfuncs(L, l, 0);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -2, "__index");
+	}
+	lua_setmetatable(L, -2);
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL)
+		return luaL_error(L, "Can't open %s", filename);
+	fseek(f, 0, SEEK_END);
+	long sz = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	r->data = (uint8_t *)malloc(sz > 0 ? sz : 1);
+	if (r->data == NULL) {
+		fclose(f);
+		return luaL_error(L, "Capture file %s OOM", filename);
+	}
+	r->size = fread(r->data, 1, sz, f);
+	fclose(f);
+
+	size_t offset = sizeof(CAPTURE_MAGIC) - 1;
+	if (!check_range(r, 0, offset + 8) || memcmp(r->data, CAPTURE_MAGIC, offset) != 0)
+		return invalid_capture(L, filename);
+	if (get_uint(r, &offset) != CAPTURE_VERSION)
+		return luaL_error(L, "Unsupported capture file version %s", filename);
+	r->materials_size = get_uint(r, &offset);
+	r->materials = offset;
+	offset += r->materials_size;
+	int cap = 0;
+	for (;;) {
+		if (!check_range(r, offset, 4))
+			return invalid_capture(L, filename);
+		size_t frame = offset;
+		uint32_t n = get_uint(r, &offset);
+		if (n == CAPTURE_END)
+			break;
+		uint32_t i;
+		for (i=0;i<n;i++) {
+			if (!check_range(r, offset, 4))
+				return invalid_capture(L, filename);
+			uint32_t prim_n = get_uint(r, &offset);
+			offset = (offset + CAPTURE_ALIGN - 1) / CAPTURE_ALIGN * CAPTURE_ALIGN;
+			if (!check_range(r, offset, (size_t)prim_n * sizeof(struct draw_primitive)))
+				return invalid_capture(L, filename);
+			offset += prim_n * sizeof(struct draw_primitive);
+		}
+		if (r->frame_n >= cap) {
+			cap = cap ? cap * 2 : 1024;
+			size_t *frames = (size_t *)realloc(r->frame, cap * sizeof(size_t));
+			if (frames == NULL)
+				return luaL_error(L, "Capture file %s OOM", filename);
+			r->frame = frames;
+		}
+		r->frame[r->frame_n++] = frame;
+	}
+	if (r->frame_n == 0)
+		return luaL_error(L, "Capture file %s has no frame", filename);
+	if (!check_range(r, offset, 8))
+		return invalid_capture(L, filename);
+	r->texture_n = get_uint(r, &offset);
+	r->rects_size = get_uint(r, &offset);
+	r->rects = offset;
+	if (!check_range(r, offset, r->rects_size))
+		return invalid_capture(L, filename);
+	return 1;
+}
+
+int
+luaopen_soluna_capture(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "writer", lcapture_writer },
+		{ "reader", lcapture_reader },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
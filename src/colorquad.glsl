@@ -1,3 +1,5 @@
+@include srdecode.glsl
+
 @vs vs
 layout(binding=0) uniform vs_params {
 	vec2 framesize;
@@ -22,7 +24,32 @@ void main() {
 	ivec2 v2 = ivec2(0 , position.w);
 	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
 	vec2 pos = (uv_offset * sr[idx].m + position.xy) * framesize;
-	gl_Position = vec4(pos.x - 1.0f, pos.y + 1.0f, 0, 1);
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
+	color = c;
+}
+
+@end
+
+// sr is decoded in vertex shader, no sr buffer
+@vs vs_direct
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+};
+
+@include_block sr_decode
+
+in vec4 position;
+in uint sr;
+in vec4 c;
+
+out vec4 color;
+
+void main() {
+	ivec2 u2 = ivec2(0 , position.z);
+	ivec2 v2 = ivec2(0 , position.w);
+	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
+	vec2 pos = (uv_offset * sr_decode(sr) + position.xy) * framesize;
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
 	color = c;
 }
 
@@ -38,4 +65,5 @@ void main() {
 }
 @end
 
-@program colorquad vs fs
\ No newline at end of file
+@program colorquad vs fs
+@program colorquad_direct vs_direct fs
@@ -1,6 +1,7 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "batch.h"
 #include "spritemgr.h"
@@ -12,14 +13,34 @@ struct draw_element {
 	int texture;
 };
 
+#define DEFAULT_DRAW 256
+
+// data grows by realloc, nobody keeps pointers to draw_element across append
 struct drawmgr {
 	struct sprite_bank *bank;
 	int cap;
 	int n;
+	int peak;
 	int bank_n;
-	struct draw_element data[1];
+	struct draw_element *data;
 };
 
+static struct draw_element *
+new_element(lua_State *L, struct drawmgr *d) {
+	if (d->n >= d->cap) {
+		int cap = d->cap * 2;
+		struct draw_element *data = (struct draw_element *)realloc(d->data, cap * sizeof(*data));
+		if (data == NULL)
+			luaL_error(L, "Too many draw (%d) : Out of memory", d->n);
+		d->data = data;
+		d->cap = cap;
+	}
+	struct draw_element *e = &d->data[d->n++];
+	if (d->n > d->peak)
+		d->peak = d->n;
+	return e;
+}
+
 static int
 ldrawmgr_len(lua_State *L) {
 	struct drawmgr * d = lua_touserdata(L, 1);
@@ -55,7 +76,7 @@ ldrawmgr_reset(lua_State *L) {
 }
 
 static int
-append_external_material(struct drawmgr * d, struct draw_primitive *base, int n, int matid, int texid) {
+append_external_material(lua_State *L, struct drawmgr * d, struct draw_primitive *base, int n, int matid, int texid) {
 	int i;
 	struct sprite_rect * rect = d->bank->rect;
 
@@ -69,7 +90,7 @@ append_external_material(struct drawmgr * d, struct draw_primitive *base, int n,
 			break;
 		}
 	}
-	struct draw_element *e = &d->data[d->n++];
+	struct draw_element *e = new_element(L, d);
 	e->base = base;
 	e->n = i;
 	e->material = -matid;
@@ -78,7 +99,7 @@ append_external_material(struct drawmgr * d, struct draw_primitive *base, int n,
 }
 
 static int
-append_default_material(struct drawmgr * d, struct draw_primitive *base, int n, int texid) {
+append_default_material(lua_State *L, struct drawmgr * d, struct draw_primitive *base, int n, int texid) {
 	int i;
 	struct sprite_rect * rect = d->bank->rect;
 	int rect_n = d->bank_n;
@@ -91,7 +112,7 @@ append_default_material(struct drawmgr * d, struct draw_primitive *base, int n,
 		if (texid != rect[sprite].texid)
 			break;
 	}
-	struct draw_element *e = &d->data[d->n++];
+	struct draw_element *e = new_element(L, d);
 	e->base = base;
 	e->n = i;
 	e->material = 0;
@@ -114,9 +135,6 @@ ldrawmgr_append(lua_State *L) {
 	for (i=0;i<prim_n;) {
 		struct draw_primitive *p = &prim[i];
 		int index = p->sprite;
-		if (d->n >= d->cap) {
-			return luaL_error(L, "Too many draw");
-		}
 		if (index <= 0) {
 			if (i == prim_n || index == 0) {
 				return luaL_error(L, "Invalid batch stream");
@@ -127,35 +145,61 @@ ldrawmgr_append(lua_State *L) {
 			if (sprite >= 0) {
 				texid = rect[sprite].texid;
 			}
-			i += append_external_material(d, p, (end_ptr - p)/2, index, texid) * 2;
+			i += append_external_material(L, d, p, (end_ptr - p)/2, index, texid) * 2;
 		} else {
 			--index;
 			if (index >= rect_n)
 				return luaL_error(L, "Invalid sprite id %d", index);
 			int texid = rect[index].texid;
-			i += append_default_material(d, p, end_ptr - p, texid);
+			i += append_default_material(L, d, p, end_ptr - p, texid);
 		}
 	}
 
 	return 0;
 }
 
+static int
+ldrawmgr_stat(lua_State *L) {
+	struct drawmgr * d = (struct drawmgr *)luaL_checkudata(L, 1, "SOLUNA_DRAWMGR");
+	lua_pushinteger(L, d->n);
+	lua_pushinteger(L, d->peak);
+	lua_pushinteger(L, d->cap);
+	return 3;
+}
+
+static int
+ldrawmgr_gc(lua_State *L) {
+	struct drawmgr * d = (struct drawmgr *)lua_touserdata(L, 1);
+	free(d->data);
+	d->data = NULL;
+	d->cap = 0;
+	d->n = 0;
+	return 0;
+}
+
 static int
 ldrawmgr_new(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TLIGHTUSERDATA);
 	void * bank = lua_touserdata(L, 1);
-	int cap = luaL_checkinteger(L, 2);
-	struct drawmgr * d = (struct drawmgr *)lua_newuserdatauv(L, sizeof(*d) + (cap-1)*sizeof(d->data[0]), 0);
+	// initial capacity, it grows when needed
+	int cap = luaL_optinteger(L, 2, DEFAULT_DRAW);
+	if (cap < 1)
+		cap = DEFAULT_DRAW;
+	struct drawmgr * d = (struct drawmgr *)lua_newuserdatauv(L, sizeof(*d), 0);
 	d->bank = (struct sprite_bank *)bank;
-	d->cap = cap;
+	d->cap = 0;
 	d->n = 0;
+	d->peak = 0;
+	d->data = NULL;
 	if (luaL_newmetatable(L, "SOLUNA_DRAWMGR")) {
 		luaL_Reg l[] = {
 			{ "__index", NULL },
 			{ "__len", ldrawmgr_len },
 			{ "__call", ldrawmgr_index },
+			{ "__gc", ldrawmgr_gc },
 			{ "reset", ldrawmgr_reset },
 			{ "append", ldrawmgr_append },
+			{ "stat", ldrawmgr_stat },
 			{ NULL, NULL },
 		};
 		luaL_setfuncs(L, l, 0);
@@ -164,6 +208,10 @@ ldrawmgr_new(lua_State *L) {
 		lua_setfield(L, -2, "__index");
 	}
 	lua_setmetatable(L, -2);
+	d->data = (struct draw_element *)malloc(cap * sizeof(d->data[0]));
+	if (d->data == NULL)
+		return luaL_error(L, "drawmgr : Out of memory");
+	d->cap = cap;
 	
 	return 1;
 }
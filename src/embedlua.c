@@ -7,7 +7,10 @@
 #include "start.lua.h"
 #include "print_r.lua.h"
 #include "loader.lua.h"
+#include "loaderworker.lua.h"
 #include "spritebundle.lua.h"
+#include "atlascache.lua.h"
+#include "atlasjob.lua.h"
 #include "render.lua.h"
 #include "settingdefault.dl.h"
 #include "settings.lua.h"
@@ -29,8 +32,10 @@
 
 #include "lua.h"
 #include "lauxlib.h"
+#include <string.h>
 
 #define REG_SOURCE(name) \
+	check_bytecode(L, #name, luasrc_##name, sizeof(luasrc_##name) - 1);	\
 	lua_pushlightuserdata(L, (void *)luasrc_##name);	\
 	lua_pushinteger(L, sizeof(luasrc_##name) - 1);	\
 	lua_pushcclosure(L, get_string, 2);	\
@@ -47,6 +52,17 @@
 	lua_pushcclosure(L, get_stringloader, 2);	\
 	lua_setfield(L, -2, #name);
 
+// The embedded sources are bytecode dumped by the lua built from 3rd/lua (script/lua2c.lua),
+// check the version byte of the header to find a stale build before load() fails with a vague error.
+static void
+check_bytecode(lua_State *L, const char *name, const unsigned char *code, size_t sz) {
+	static const int version = LUA_VERSION_MAJOR_N * 16 + LUA_VERSION_MINOR_N;
+	if (sz < 5 || memcmp(code, LUA_SIGNATURE, 4) != 0)
+		luaL_error(L, "Embedded %s is not lua bytecode", name);
+	if (code[4] != version)
+		luaL_error(L, "Embedded %s is compiled for lua %d.%d, but lua %d.%d is linked", name, code[4] >> 4, code[4] & 0xf, version >> 4, version & 0xf);
+}
+
 static int
 get_string(lua_State *L) {
 	const char * s = (const char *)lua_touserdata(L, lua_upvalueindex(1));
@@ -76,6 +92,8 @@ luaopen_embedsource(lua_State *L) {
 
 		lua_newtable(L);	// runtime
 			REG_SOURCE(spritebundle)
+			REG_SOURCE(atlascache)
+			REG_SOURCE(atlasjob)
 			REG_SOURCE(icon)
 			REG_SOURCE(layout)
 			REG_SOURCE(text)
@@ -91,6 +109,7 @@ luaopen_embedsource(lua_State *L) {
 			REG_SOURCE(timer)
 			REG_SOURCE(start)
 			REG_SOURCE(loader)
+			REG_SOURCE(loaderworker)
 			REG_SOURCE(render)
 			REG_SOURCE(gamepad)
 			REG_SOURCE(settings)
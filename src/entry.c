@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <locale.h>
 
 #if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
@@ -44,6 +45,7 @@
 #include "sokol/sokol_log.h"
 #include "sokol/sokol_args.h"
 #include "loginfo.h"
+#include "trace.h"
 #include "appevent.h"
 #include "ime_state.h"
 
@@ -114,9 +116,36 @@ struct soluna_string_message {
 	char data[];
 };
 
+// Fixed size records are recycled from a pool, only the main thread allocates them (lmessage_send),
+// and the start service releases them (lmessage_unpack). Fall back to malloc when the pool is used up.
+#define MESSAGE_POOL_SIZE 1024
+
+struct message_pool {
+	int cursor;
+	atomic_int used[MESSAGE_POOL_SIZE];
+	struct soluna_message slot[MESSAGE_POOL_SIZE];
+};
+
+static struct message_pool MESSAGE_POOL;
+
+static inline struct soluna_message *
+message_alloc(void) {
+	struct message_pool *P = &MESSAGE_POOL;
+	int i;
+	for (i=0;i<MESSAGE_POOL_SIZE;i++) {
+		int idx = (P->cursor + i) % MESSAGE_POOL_SIZE;
+		if (atomic_load_explicit(&P->used[idx], memory_order_acquire) == 0) {
+			atomic_store_explicit(&P->used[idx], 1, memory_order_relaxed);
+			P->cursor = idx + 1;
+			return &P->slot[idx];
+		}
+	}
+	return (struct soluna_message *)malloc(sizeof(struct soluna_message));
+}
+
 static inline struct soluna_message *
 message_create(const char *type, int p1, int p2) {
-	struct soluna_message *msg = (struct soluna_message *)malloc(sizeof(*msg));
+	struct soluna_message *msg = message_alloc();
 	msg->type = type;
 	msg->v.p[0] = p1;
 	msg->v.p[1] = p2;
@@ -125,7 +154,7 @@ message_create(const char *type, int p1, int p2) {
 
 static inline struct soluna_message *
 message_create64(const char *type, uint64_t p) {
-	struct soluna_message *msg = (struct soluna_message *)malloc(sizeof(*msg));
+	struct soluna_message *msg = message_alloc();
 	msg->type = type;
 	msg->v.u64 = p;
 	return msg;
@@ -143,9 +172,38 @@ message_create_string(const char *type, const char *str, size_t len) {
 
 static inline void
 message_release(struct soluna_message *msg) {
-	free(msg);
+	struct message_pool *P = &MESSAGE_POOL;
+	uintptr_t p = (uintptr_t)msg;
+	if (p >= (uintptr_t)&P->slot[0] && p < (uintptr_t)&P->slot[MESSAGE_POOL_SIZE]) {
+		atomic_store_explicit(&P->used[msg - P->slot], 0, memory_order_release);
+	} else {
+		free(msg);
+	}
 }
 
+// Consecutive mouse_move / touch_moved events are merged into the latest one (setting coalesce_move),
+// touches are merged by identifier, so a changed touch is not lost,
+// they are dispatched before any other event or the next frame.
+struct move_coalesce {
+	bool enable;
+	bool pending;
+	sapp_event ev;
+};
+
+static struct move_coalesce MOVE_COALESCE;
+
+// Time from sokol_main to app_init done and to the first frame, printed when setting startup_benchmark is true.
+// The whole startup timeline (see trace.c) is written to the file of setting startup_trace.
+struct startup_benchmark {
+	bool enable;
+	bool done;
+	double init;
+	const char *trace;
+	char trace_file[256];
+};
+
+static struct startup_benchmark STARTUP;
+
 void
 soluna_emit_char(uint32_t codepoint, uint32_t modifiers, bool repeat) {
 	sapp_event ev;
@@ -620,6 +678,13 @@ linit_desc(lua_State *L) {
 	desc_get_boolean(L, &d->enable_clipboard, 2, "enable_clipboard");
 	desc_get_int(L, &d->clipboard_size, 2, "clipboard_size");
 	desc_get_string(L, &d->window_title, 2, "window_title");
+	desc_get_boolean(L, &MOVE_COALESCE.enable, 2, "coalesce_move");
+	desc_get_boolean(L, &STARTUP.enable, 2, "startup_benchmark");
+	desc_get_string(L, &STARTUP.trace, 2, "startup_trace");
+	if (STARTUP.trace) {
+		snprintf(STARTUP.trace_file, sizeof(STARTUP.trace_file), "%s", STARTUP.trace);
+		STARTUP.trace = STARTUP.trace_file;
+	}
 
 	return 0;
 }
@@ -658,7 +723,9 @@ log_func(const char* tag, uint32_t log_level, uint32_t log_item, const char* mes
 		fprintf(stderr, "%s (%d) : %s\n", filename, line_nr, message);
 		return;
 	}
-	struct log_info *msg = (struct log_info *)malloc(sizeof(*msg));
+	struct log_info *msg = log_info_alloc();
+	if (msg == NULL)
+		return;
 	if (tag) {
 		strncpy(msg->tag, tag, sizeof(msg->tag));
 		msg->tag[sizeof(msg->tag)-1] = 0;
@@ -819,7 +886,10 @@ app_init() {
 	});
 		
 	lua_State *L = CTX->L;
-	if (start_app(L)) {
+	soluna_trace("start_app", 'B', 0);
+	int err = start_app(L);
+	soluna_trace("start_app", 'E', 0);
+	if (err) {
 		if (L) {
 			lua_close(L);
 		}
@@ -827,6 +897,7 @@ app_init() {
 		CTX->quitL = NULL;
 		sapp_quit();
 	}
+	STARTUP.init = soluna_trace_time();
 }
 
 static lua_State *
@@ -854,12 +925,82 @@ invoke_callback(lua_State *L, int index, int nargs) {
 	}
 }
 
+static void
+dispatch_event(lua_State *L, const sapp_event *ev) {
+	lua_pushlightuserdata(L, (void *)ev);
+	invoke_callback(L, EVENT_CALLBACK, 1);
+}
+
+static void
+flush_move_event(lua_State *L) {
+	if (MOVE_COALESCE.pending) {
+		MOVE_COALESCE.pending = false;
+		dispatch_event(L, &MOVE_COALESCE.ev);
+	}
+}
+
+// Merge a touches moved event into the pending one : the latest position of each touch,
+// a touch is changed if it's changed in any of them
+static void
+merge_touches(sapp_event *pending, const sapp_event *ev) {
+	sapp_event merged = *ev;
+	int i, j;
+	for (i = 0; i < pending->num_touches; i++) {
+		const sapp_touchpoint *t = &pending->touches[i];
+		for (j = 0; j < merged.num_touches; j++) {
+			if (merged.touches[j].identifier == t->identifier) {
+				merged.touches[j].changed |= t->changed;
+				break;
+			}
+		}
+		if (j == merged.num_touches && t->changed && merged.num_touches < SAPP_MAX_TOUCHPOINTS) {
+			// not in the newest event, keep its last move
+			merged.touches[merged.num_touches++] = *t;
+		}
+	}
+	*pending = merged;
+}
+
+static int
+coalesce_move_event(lua_State *L, const sapp_event *ev) {
+	struct move_coalesce *C = &MOVE_COALESCE;
+	if (!C->enable)
+		return 0;
+	if (ev->type != SAPP_EVENTTYPE_MOUSE_MOVE && ev->type != SAPP_EVENTTYPE_TOUCHES_MOVED)
+		return 0;
+	if (C->pending && C->ev.type != ev->type)
+		flush_move_event(L);
+	if (C->pending && ev->type == SAPP_EVENTTYPE_TOUCHES_MOVED) {
+		merge_touches(&C->ev, ev);
+		return 1;
+	}
+	float dx = 0, dy = 0;
+	if (C->pending) {
+		dx = C->ev.mouse_dx;
+		dy = C->ev.mouse_dy;
+	}
+	C->ev = *ev;
+	C->ev.mouse_dx += dx;
+	C->ev.mouse_dy += dy;
+	C->pending = true;
+	return 1;
+}
+
 static void
 app_frame() {
 	lua_State *L = get_L(CTX);
 	if (L) {
+		flush_move_event(L);
 		lua_pushinteger(L, sapp_frame_count());
 		invoke_callback(L, FRAME_CALLBACK, 1);
+		if (!STARTUP.done) {
+			STARTUP.done = true;
+			soluna_trace("first_frame", 'i', 0);
+			if (STARTUP.enable)
+				printf("Startup : init %.2f ms, first frame %.2f ms\n", STARTUP.init, soluna_trace_time());
+			if (STARTUP.trace && soluna_trace_write(STARTUP.trace))
+				fprintf(stderr, "Can't write startup trace to %s\n", STARTUP.trace);
+		}
 	}
 }
 
@@ -923,8 +1064,10 @@ app_event(const sapp_event* ev) {
 #endif
 	lua_State *L = get_L(CTX);
 	if (L) {
-		lua_pushlightuserdata(L, (void *)ev);
-		invoke_callback(L, EVENT_CALLBACK, 1);
+		if (coalesce_move_event(L, ev))
+			return;
+		flush_move_event(L);
+		dispatch_event(L, ev);
 	}
 }
 
@@ -950,6 +1093,7 @@ init_settings(lua_State *L, sapp_desc *desc) {
 
 sapp_desc
 sokol_main(int argc, char* argv[]) {
+	soluna_trace("sokol_main", 'i', 0);
 	// init sargs
 	sargs_desc arg_desc;
 	memset(&arg_desc, 0, sizeof(arg_desc));
@@ -981,16 +1125,21 @@ sokol_main(int argc, char* argv[]) {
 		lua_pushcfunction(L, pmain);
 		lua_pushlightuserdata(L, (void *)argv);
 		
-		if (lua_pcall(L, 1, 1, 1) != LUA_OK) {
+		soluna_trace("lua_init", 'B', 0);
+		int status = lua_pcall(L, 1, 1, 1);
+		soluna_trace("lua_init", 'E', 0);
+		if (status != LUA_OK) {
 			const char * err = lua_tostring(L, -1);
 			lua_pushlightuserdata(L, (void *)err);
 			lua_replace(L, 1);
 		}
 		sargs_shutdown();
 		
+		soluna_trace("init_settings", 'B', 0);
 		if (init_settings(L, &d)) {
 			lua_replace(L, 1);
 		}
+		soluna_trace("init_settings", 'E', 0);
 	}
 
 	app.L = L;
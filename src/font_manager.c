@@ -529,6 +529,15 @@ font_manager_flush(struct font_manager *F) {
 	return dirty;
 }
 
+// changed by font_manager_flush, once per frame
+int
+font_manager_version(struct font_manager *F) {
+	lock(F);
+	int version = F->version;
+	unlock(F);
+	return version;
+}
+
 static void
 font_manager_import_unsafe(struct font_manager *F, void* fontdata, size_t sz) {
 	truetype_import(F->L, fontdata, sz);
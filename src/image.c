@@ -514,6 +514,226 @@ canvas_blit(lua_State *L) {
 	return 0;
 }
 
+// A list of blits for blit_many(), see image_blit_list()
+struct blit_entry {
+	const uint8_t *ptr;
+	int width;
+	int height;
+	int stride;
+	int x;
+	int y;
+};
+
+static inline void
+premultiply_pixels(uint8_t *dst, const uint8_t *src, int n) {
+	int i;
+	for (i=0;i<n;i++) {
+		const uint8_t *s = src + i * 4;
+		uint8_t *d = dst + i * 4;
+		uint32_t a = s[3];
+		d[0] = (uint8_t)((s[0] * a + 127) / 255);
+		d[1] = (uint8_t)((s[1] * a + 127) / 255);
+		d[2] = (uint8_t)((s[2] * a + 127) / 255);
+		d[3] = (uint8_t)a;
+	}
+}
+
+static inline void
+copy_pixels(uint8_t *dst, const uint8_t *src, int n, int premultiply) {
+	if (premultiply)
+		premultiply_pixels(dst, src, n);
+	else
+		memcpy(dst, src, n * 4);
+}
+
+// Blit e into the rows [y0, y1) of dst. With extrude, the edge pixels of e are repeated 1 pixel outside,
+// so the caller must keep 2 pixels between the rects at least.
+static void
+blit_entry(struct canvas *dst, const struct blit_entry *e, int y0, int y1, int premultiply, int extrude) {
+	int w = e->width;
+	int h = e->height;
+	if (w <= 0 || h <= 0)
+		return;
+	int from = e->y - extrude;
+	int to = e->y + h + extrude;
+	if (from < y0)
+		from = y0;
+	if (to > y1)
+		to = y1;
+	// copy the columns [left, right) of src, and the extruded ones out of it
+	int left = e->x < 0 ? -e->x : 0;
+	int right = e->x + w > dst->width ? dst->width - e->x : w;
+	int extrude_left = extrude && e->x > 0 && e->x <= dst->width;
+	int extrude_right = extrude && e->x + w >= 0 && e->x + w < dst->width;
+	int row;
+	for (row=from;row<to;row++) {
+		int sy = row - e->y;
+		if (sy < 0)
+			sy = 0;
+		else if (sy >= h)
+			sy = h - 1;
+		const uint8_t *src = e->ptr + sy * e->stride;
+		uint8_t *line = (uint8_t *)dst->buffer + row * dst->stride + e->x * 4;
+		if (left < right)
+			copy_pixels(line + left * 4, src + left * 4, right - left, premultiply);
+		if (extrude_left)
+			copy_pixels(line - 4, src, 1, premultiply);
+		if (extrude_right)
+			copy_pixels(line + w * 4, src + (w - 1) * 4, 1, premultiply);
+	}
+}
+
+// blit_list { canvas1, x1, y1, canvas2, x2, y2, ... } : returns a list for blit_many().
+// It refers to the buffers of the canvases, keep them alive until blit_many() is done.
+static int
+image_blit_list(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	int n = (int)lua_rawlen(L, 1);
+	if (n % 3 != 0)
+		return luaL_error(L, "Invalid blit list size %d", n);
+	n /= 3;
+	luaL_Buffer b;
+	struct blit_entry *list = (struct blit_entry *)luaL_buffinitsize(L, &b, n * sizeof(struct blit_entry));
+	int i;
+	for (i=0;i<n;i++) {
+		lua_rawgeti(L, 1, i * 3 + 1);
+		check_canvas(L, -1);
+		struct canvas *c = (struct canvas *)lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		struct blit_entry *e = &list[i];
+		e->ptr = (const uint8_t *)c->buffer;
+		e->width = c->width;
+		e->height = c->height;
+		e->stride = c->stride;
+		lua_rawgeti(L, 1, i * 3 + 2);
+		e->x = (int)luaL_checkinteger(L, -1);
+		lua_rawgeti(L, 1, i * 3 + 3);
+		e->y = (int)luaL_checkinteger(L, -1);
+		lua_pop(L, 2);
+	}
+	luaL_pushresultsize(&b, n * sizeof(struct blit_entry));
+	return 1;
+}
+
+// blit_many(dst, list, y0, y1, premultiply, extrude) : blit the list from blit_list() into the rows [y0, y1) of dst.
+// Different bands of the same canvas can be filled by different threads, see loader.lua S.blit
+static int
+canvas_blit_many(lua_State *L) {
+	if (check_canvas(L, 1) == LUA_TSTRING)
+		return luaL_error(L, "dst canvas is readonly");
+	struct canvas * dst = (struct canvas *)lua_touserdata(L, 1);
+	size_t sz;
+	const struct blit_entry *list = (const struct blit_entry *)luaL_checklstring(L, 2, &sz);
+	if (sz % sizeof(struct blit_entry) != 0)
+		return luaL_error(L, "Invalid blit list");
+	int y0 = luaL_optinteger(L, 3, 0);
+	int y1 = luaL_optinteger(L, 4, dst->height);
+	int premultiply = lua_toboolean(L, 5);
+	int extrude = lua_toboolean(L, 6);
+	if (y0 < 0)
+		y0 = 0;
+	if (y1 > dst->height)
+		y1 = dst->height;
+	int n = (int)(sz / sizeof(struct blit_entry));
+	int i;
+	for (i=0;i<n;i++) {
+		blit_entry(dst, &list[i], y0, y1, premultiply, extrude);
+	}
+	return 0;
+}
+
+// 2x2 box filter weighted by alpha, so the color of transparent pixels doesn't bleed into the edges.
+// One row of dst at a time. The division is a multiply by the float reciprocal, an integer division
+// by a per pixel divisor blocks the vectorizer. The result is the same as (n + half) / div :
+// n < 2^18 is exact in float, and the bias covers the rounding error without reaching the next integer (div <= 1020).
+#define DOWNSAMPLE_BIAS (1.0f / 2048.0f)
+
+static void
+downsample_row(uint8_t *dst, const uint8_t *s0, const uint8_t *s1, int w) {
+	int i;
+	for (i=0;i<w;i++) {
+		const uint8_t *a = s0 + i * 8;
+		const uint8_t *b = s1 + i * 8;
+		uint32_t a0 = a[3], a1 = a[7], a2 = b[3], a3 = b[7];
+		uint32_t alpha = a0 + a1 + a2 + a3;
+		uint32_t half = alpha >> 1;
+		float inv = 1.0f / (float)(alpha | (alpha == 0));
+		uint8_t *d = dst + i * 4;
+		d[0] = (uint8_t)((float)(a[0] * a0 + a[4] * a1 + b[0] * a2 + b[4] * a3 + half) * inv + DOWNSAMPLE_BIAS);
+		d[1] = (uint8_t)((float)(a[1] * a0 + a[5] * a1 + b[1] * a2 + b[5] * a3 + half) * inv + DOWNSAMPLE_BIAS);
+		d[2] = (uint8_t)((float)(a[2] * a0 + a[6] * a1 + b[2] * a2 + b[6] * a3 + half) * inv + DOWNSAMPLE_BIAS);
+		d[3] = (uint8_t)((alpha + 2) >> 2);
+	}
+}
+
+// Premultiplied colors don't bleed, a plain 2x2 box filter
+static void
+downsample_row_premultiplied(uint8_t *dst, const uint8_t *s0, const uint8_t *s1, int w) {
+	int i, j;
+	for (i=0;i<w;i++) {
+		const uint8_t *a = s0 + i * 8;
+		const uint8_t *b = s1 + i * 8;
+		uint8_t *d = dst + i * 4;
+		for (j=0;j<4;j++) {
+			d[j] = (uint8_t)((a[j] + a[j+4] + b[j] + b[j+4] + 2) >> 2);
+		}
+	}
+}
+
+static void
+downsample(uint8_t *dst, int dst_stride, const uint8_t *src, int src_stride, int w, int h, int premultiplied) {
+	int i;
+	for (i=0;i<h;i++) {
+		const uint8_t *s0 = src + i * 2 * src_stride;
+		if (premultiplied)
+			downsample_row_premultiplied(dst + i * dst_stride, s0, s0 + src_stride, w);
+		else
+			downsample_row(dst + i * dst_stride, s0, s0 + src_stride, w);
+	}
+}
+
+// downsample(dst, src [, premultiplied]) : dst is (src.width / 2, src.height / 2), one level of mipmap
+static int
+canvas_downsample(lua_State *L) {
+	if (check_canvas(L, 1) == LUA_TSTRING)
+		return luaL_error(L, "dst canvas is readonly");
+	check_canvas(L, 2);
+	struct canvas * dst = (struct canvas *)lua_touserdata(L, 1);
+	struct canvas * src = (struct canvas *)lua_touserdata(L, 2);
+	if (dst->width * 2 > src->width || dst->height * 2 > src->height)
+		return luaL_error(L, "Invalid downsample size (%d %d) from (%d %d)", dst->width, dst->height, src->width, src->height);
+	downsample((uint8_t *)dst->buffer, dst->stride, (const uint8_t *)src->buffer, src->stride, dst->width, dst->height, lua_toboolean(L, 3));
+	return 0;
+}
+
+// mipmap(size, [premultiplied,] level0, level1, ...) : levels are pointers of square RGBA images, level0 is size * size.
+// Fill level1 ... from level0, it's called by loader workers, see loader.lua S.mipmap
+static int
+image_mipmap(lua_State *L) {
+	int size = luaL_checkinteger(L, 1);
+	int premultiplied = 0;
+	int from = 2;
+	if (lua_type(L, 2) == LUA_TBOOLEAN) {
+		premultiplied = lua_toboolean(L, 2);
+		from = 3;
+	}
+	int n = lua_gettop(L);
+	int i;
+	for (i=from;i<=n;i++) {
+		luaL_checktype(L, i, LUA_TLIGHTUSERDATA);
+	}
+	for (i=from+1;i<=n;i++) {
+		if (size < 2)
+			return luaL_error(L, "Too many mipmap levels %d", n - from);
+		const uint8_t *src = (const uint8_t *)lua_touserdata(L, i-1);
+		uint8_t *dst = (uint8_t *)lua_touserdata(L, i);
+		int dsize = size / 2;
+		downsample(dst, dsize * 4, src, size * 4, dsize, dsize, premultiplied);
+		size = dsize;
+	}
+	return 0;
+}
+
 static int
 image_makeindex(lua_State *L) {
 	if (lua_isnoneornil(L, 1)) {
@@ -587,6 +807,10 @@ luaopen_image(lua_State *L) {
 		{ "canvas_size", image_canvas_size },
 		{ "new", image_new },
 		{ "blit", canvas_blit },
+		{ "blit_list", image_blit_list },
+		{ "blit_many", canvas_blit_many },
+		{ "downsample", canvas_downsample },
+		{ "mipmap", image_mipmap },
 		{ "makeindex", image_makeindex },
 		{ NULL, NULL },
 	};
@@ -0,0 +1,407 @@
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+// BC3 (DXT5) encoder for sprite textures. Each 4x4 block is 16 bytes :
+// 8 bytes alpha (2 endpoints and 3 bits indices), 8 bytes color (2 RGB565 endpoints and 2 bits indices).
+// Colors use the principal axis of the block for the endpoints, then refine them by least squares once.
+
+#define BLOCK_SIZE 16
+
+static void
+load_block(uint8_t block[16][4], const uint8_t *src, int stride, int w, int h, int x, int y) {
+	int i, j;
+	for (j=0;j<4;j++) {
+		int yy = y + j < h ? y + j : h - 1;
+		const uint8_t *line = src + yy * stride;
+		for (i=0;i<4;i++) {
+			int xx = x + i < w ? x + i : w - 1;
+			memcpy(block[j*4+i], line + xx * 4, 4);
+		}
+	}
+}
+
+static void
+encode_alpha(uint8_t out[8], uint8_t block[16][4]) {
+	int amin = 255, amax = 0;
+	int i;
+	for (i=0;i<16;i++) {
+		int a = block[i][3];
+		if (a < amin)
+			amin = a;
+		if (a > amax)
+			amax = a;
+	}
+	out[0] = (uint8_t)amax;
+	out[1] = (uint8_t)amin;
+	uint64_t bits = 0;
+	int range = amax - amin;
+	if (range > 0) {
+		// a0 > a1 : 8 values, index 0 is a0, 1 is a1, i (2..7) is ((8-i) * a0 + (i-1) * a1) / 7
+		for (i=0;i<16;i++) {
+			int level = ((block[i][3] - amin) * 7 + range / 2) / range;
+			uint64_t index = level == 7 ? 0 : (level == 0 ? 1 : 8 - level);
+			bits |= index << (i * 3);
+		}
+	}
+	for (i=0;i<6;i++) {
+		out[2+i] = (uint8_t)(bits >> (i * 8));
+	}
+}
+
+static inline int
+clamp255(float v) {
+	int c = (int)(v + 0.5f);
+	return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+static inline uint16_t
+pack565(int r, int g, int b) {
+	return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static inline void
+unpack565(uint16_t c, int rgb[3]) {
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void
+make_palette(uint16_t c0, uint16_t c1, int palette[4][3]) {
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	int i;
+	for (i=0;i<3;i++) {
+		palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+		palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+	}
+}
+
+// returns the squared error, fill indices
+static int
+match_colors(uint8_t block[16][4], uint16_t c0, uint16_t c1, uint8_t indices[16]) {
+	int palette[4][3];
+	make_palette(c0, c1, palette);
+	int err = 0;
+	int i, j;
+	for (i=0;i<16;i++) {
+		int best = 0x7fffffff;
+		int index = 0;
+		for (j=0;j<4;j++) {
+			int dr = block[i][0] - palette[j][0];
+			int dg = block[i][1] - palette[j][1];
+			int db = block[i][2] - palette[j][2];
+			int d = dr * dr + dg * dg + db * db;
+			if (d < best) {
+				best = d;
+				index = j;
+			}
+		}
+		indices[i] = (uint8_t)index;
+		err += best;
+	}
+	return err;
+}
+
+static void
+principal_endpoints(uint8_t block[16][4], float e0[3], float e1[3]) {
+	float mean[3] = { 0, 0, 0 };
+	int i, j;
+	for (i=0;i<16;i++) {
+		for (j=0;j<3;j++)
+			mean[j] += block[i][j];
+	}
+	for (j=0;j<3;j++)
+		mean[j] /= 16.0f;
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (i=0;i<16;i++) {
+		float r = block[i][0] - mean[0];
+		float g = block[i][1] - mean[1];
+		float b = block[i][2] - mean[2];
+		cov[0] += r * r;
+		cov[1] += r * g;
+		cov[2] += r * b;
+		cov[3] += g * g;
+		cov[4] += g * b;
+		cov[5] += b * b;
+	}
+	// power iteration
+	float axis[3] = { 0.577f, 0.577f, 0.577f };
+	for (i=0;i<6;i++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = sqrtf(x * x + y * y + z * z);
+		if (len < 1e-6f)
+			break;
+		axis[0] = x / len;
+		axis[1] = y / len;
+		axis[2] = z / len;
+	}
+	float tmin = 0, tmax = 0;
+	for (i=0;i<16;i++) {
+		float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		if (t < tmin)
+			tmin = t;
+		if (t > tmax)
+			tmax = t;
+	}
+	// inset the endpoints a little, the extreme colors are rare
+	float inset = (tmax - tmin) / 32.0f;
+	tmax -= inset;
+	tmin += inset;
+	for (j=0;j<3;j++) {
+		e0[j] = mean[j] + axis[j] * tmax;
+		e1[j] = mean[j] + axis[j] * tmin;
+	}
+}
+
+// least squares endpoints for the indices, returns 0 if it's singular
+static int
+refine_endpoints(uint8_t block[16][4], const uint8_t indices[16], float e0[3], float e1[3]) {
+	static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0, ab = 0, bb = 0;
+	float ax[3] = { 0, 0, 0 };
+	float bx[3] = { 0, 0, 0 };
+	int i, j;
+	for (i=0;i<16;i++) {
+		float a = weight[indices[i]];
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (j=0;j<3;j++) {
+			ax[j] += a * block[i][j];
+			bx[j] += b * block[i][j];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return 0;
+	float inv = 1.0f / det;
+	for (j=0;j<3;j++) {
+		e0[j] = (ax[j] * bb - bx[j] * ab) * inv;
+		e1[j] = (bx[j] * aa - ax[j] * ab) * inv;
+	}
+	return 1;
+}
+
+static inline uint16_t
+endpoint565(const float e[3]) {
+	return pack565(clamp255(e[0]), clamp255(e[1]), clamp255(e[2]));
+}
+
+static void
+write_color(uint8_t out[8], uint16_t c0, uint16_t c1, const uint8_t indices[16]) {
+	// BC3 always uses 4 colors, but keep c0 > c1 for the decoders follow BC1 rules
+	static const uint8_t swap[4] = { 1, 0, 3, 2 };
+	int need_swap = c0 < c1;
+	if (need_swap) {
+		uint16_t tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	uint32_t bits = 0;
+	int i;
+	for (i=0;i<16;i++) {
+		uint32_t index = need_swap ? swap[indices[i]] : indices[i];
+		if (c0 == c1)
+			index = 0;
+		bits |= index << (i * 2);
+	}
+	out[4] = bits & 0xff;
+	out[5] = (bits >> 8) & 0xff;
+	out[6] = (bits >> 16) & 0xff;
+	out[7] = bits >> 24;
+}
+
+static void
+encode_color(uint8_t out[8], uint8_t block[16][4]) {
+	float e0[3], e1[3];
+	principal_endpoints(block, e0, e1);
+	uint16_t c0 = endpoint565(e0);
+	uint16_t c1 = endpoint565(e1);
+	uint8_t indices[16];
+	int err = match_colors(block, c0, c1, indices);
+	if (err > 0 && refine_endpoints(block, indices, e0, e1)) {
+		uint16_t r0 = endpoint565(e0);
+		uint16_t r1 = endpoint565(e1);
+		uint8_t refined[16];
+		int rerr = match_colors(block, r0, r1, refined);
+		if (rerr < err) {
+			c0 = r0;
+			c1 = r1;
+			memcpy(indices, refined, sizeof(indices));
+		}
+	}
+	write_color(out, c0, c1, indices);
+}
+
+static void
+encode_bc3(uint8_t *dst, const uint8_t *src, int stride, int w, int h) {
+	int x, y;
+	uint8_t block[16][4];
+	for (y=0;y<h;y+=4) {
+		for (x=0;x<w;x+=4) {
+			load_block(block, src, stride, w, h, x, y);
+			encode_alpha(dst, block);
+			encode_color(dst + 8, block);
+			dst += BLOCK_SIZE;
+		}
+	}
+}
+
+static void
+decode_block(const uint8_t *b, uint8_t block[16][4]) {
+	int alpha[8];
+	alpha[0] = b[0];
+	alpha[1] = b[1];
+	int i;
+	if (alpha[0] > alpha[1]) {
+		for (i=2;i<8;i++)
+			alpha[i] = ((8 - i) * alpha[0] + (i - 1) * alpha[1]) / 7;
+	} else {
+		for (i=2;i<6;i++)
+			alpha[i] = ((6 - i) * alpha[0] + (i - 1) * alpha[1]) / 5;
+		alpha[6] = 0;
+		alpha[7] = 255;
+	}
+	uint64_t abits = 0;
+	for (i=0;i<6;i++)
+		abits |= (uint64_t)b[2+i] << (i * 8);
+	uint16_t c0 = b[8] | b[9] << 8;
+	uint16_t c1 = b[10] | b[11] << 8;
+	int palette[4][3];
+	make_palette(c0, c1, palette);
+	uint32_t cbits = b[12] | b[13] << 8 | b[14] << 16 | (uint32_t)b[15] << 24;
+	for (i=0;i<16;i++) {
+		int c = (cbits >> (i * 2)) & 3;
+		block[i][0] = (uint8_t)palette[c][0];
+		block[i][1] = (uint8_t)palette[c][1];
+		block[i][2] = (uint8_t)palette[c][2];
+		block[i][3] = (uint8_t)alpha[(abits >> (i * 3)) & 7];
+	}
+}
+
+static size_t
+bc3_size(int w, int h) {
+	return (size_t)((w + 3) / 4) * ((h + 3) / 4) * BLOCK_SIZE;
+}
+
+static const uint8_t *
+get_buffer(lua_State *L, int index, size_t sz) {
+	if (lua_type(L, index) == LUA_TLIGHTUSERDATA)
+		return (const uint8_t *)lua_touserdata(L, index);
+	size_t len;
+	const char *buffer = luaL_checklstring(L, index, &len);
+	if (len != sz)
+		luaL_error(L, "Invalid buffer size %d != %d", (int)len, (int)sz);
+	return (const uint8_t *)buffer;
+}
+
+static void *
+free_buffer(void *ud, void *ptr, size_t osize, size_t nsize) {
+	free(ptr);
+	return NULL;
+}
+
+// encode(rgba, w, h) : rgba is a string or a pointer, returns BC3 blocks
+static int
+lencode(lua_State *L) {
+	int w = luaL_checkinteger(L, 2);
+	int h = luaL_checkinteger(L, 3);
+	if (w <= 0 || h <= 0)
+		return luaL_error(L, "Invalid size %d * %d", w, h);
+	const uint8_t *src = get_buffer(L, 1, (size_t)w * h * 4);
+	size_t sz = bc3_size(w, h);
+	uint8_t *dst = (uint8_t *)malloc(sz + 1);
+	if (dst == NULL)
+		return luaL_error(L, "Out of memory");
+	dst[sz] = 0;
+	encode_bc3(dst, src, w * 4, w, h);
+	lua_pushexternalstring(L, (const char *)dst, sz, free_buffer, NULL);
+	return 1;
+}
+
+// decode(blocks, w, h) : returns rgba string
+static int
+ldecode(lua_State *L) {
+	int w = luaL_checkinteger(L, 2);
+	int h = luaL_checkinteger(L, 3);
+	if (w <= 0 || h <= 0)
+		return luaL_error(L, "Invalid size %d * %d", w, h);
+	const uint8_t *src = get_buffer(L, 1, bc3_size(w, h));
+	luaL_Buffer b;
+	uint8_t *dst = (uint8_t *)luaL_buffinitsize(L, &b, (size_t)w * h * 4);
+	uint8_t block[16][4];
+	int x, y, i, j;
+	for (y=0;y<h;y+=4) {
+		for (x=0;x<w;x+=4) {
+			decode_block(src, block);
+			src += BLOCK_SIZE;
+			for (j=0;j<4 && y+j<h;j++) {
+				for (i=0;i<4 && x+i<w;i++) {
+					memcpy(dst + ((y + j) * w + x + i) * 4, block[j*4+i], 4);
+				}
+			}
+		}
+	}
+	luaL_pushresultsize(&b, (size_t)w * h * 4);
+	return 1;
+}
+
+// psnr(a, b, w, h) : peak signal-to-noise ratio (dB) of two rgba images
+static int
+lpsnr(lua_State *L) {
+	int w = luaL_checkinteger(L, 3);
+	int h = luaL_checkinteger(L, 4);
+	size_t n = (size_t)w * h * 4;
+	const uint8_t *a = get_buffer(L, 1, n);
+	const uint8_t *b = get_buffer(L, 2, n);
+	double sum = 0;
+	size_t i;
+	for (i=0;i<n;i++) {
+		int d = a[i] - b[i];
+		sum += d * d;
+	}
+	if (sum == 0) {
+		lua_pushnumber(L, HUGE_VAL);
+	} else {
+		double mse = sum / n;
+		lua_pushnumber(L, 10.0 * log10(255.0 * 255.0 / mse));
+	}
+	return 1;
+}
+
+static int
+lsize(lua_State *L) {
+	int w = luaL_checkinteger(L, 1);
+	int h = luaL_checkinteger(L, 2);
+	lua_pushinteger(L, bc3_size(w, h));
+	return 1;
+}
+
+int
+luaopen_image_bc(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "encode", lencode },
+		{ "decode", ldecode },
+		{ "psnr", lpsnr },
+		{ "size", lsize },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef soluna_inst_stream_h
+#define soluna_inst_stream_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sokol/sokol_gfx.h"
+
+// Per frame staging block of a stream instance buffer (see render.inst_stream).
+// Materials write instances into it directly at submit, and it's uploaded by one append per frame.
+struct inst_stream {
+	sg_buffer buffer;
+	size_t cap;
+	size_t n;
+	size_t flushed;
+	uint8_t data[1];
+};
+
+static inline void *
+inst_stream_alloc(struct inst_stream *s, size_t sz) {
+	if (s->n + sz > s->cap)
+		return NULL;
+	void *ptr = s->data + s->n;
+	s->n += sz;
+	return ptr;
+}
+
+// give back the unused tail of the last alloc
+static inline void
+inst_stream_shrink(struct inst_stream *s, size_t sz) {
+	s->n -= sz;
+}
+
+#endif
@@ -12,4 +12,8 @@ struct log_info {
 	const char *filename;	
 };
 
+// see writelog.c, returns NULL (and counts a dropped message) when all records are in flight
+struct log_info * log_info_alloc(void);
+void log_info_free(struct log_info *info);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+local file = require "soluna.file"
+local crypt = require "soluna.crypt"
+local zip = require "soluna.zip"
+
+local io = io
+local string = string
+local table = table
+
+global ipairs, rawget, tostring, type, pcall
+
+-- Baked sprite atlas : cropped sprite descs, packed rects and texture pages of one bundle.
+-- A cache file is valid only for the same bundle source, the same images and the same sprite bank
+-- state before loading, so restoring it gives exactly what spritebundle.crop and bank:pack would do.
+
+local M = {}
+
+local MAGIC <const> = "SOLUNA_ATLAS"
+local VERSION <const> = 2
+-- magic, version, key, texture_n, texid from, page number
+local HEADER <const> = "<c12I4c20I4I4I4"
+local SPRITE <const> = "<i4i4i4i4i4i4"
+
+function M.filename(path, bundle)
+	return path .. crypt.hexencode(crypt.sha1(bundle)) .. ".atlas"
+end
+
+local function content(filecache, filename)
+	local c = rawget(filecache, filename)
+	if c then
+		-- preload image
+		return c.data
+	end
+	return file.load(filename) or ""
+end
+
+function M.key(filename, desc, bank, filecache, texture_size, mipmap, compress, premultiply)
+	local h = { filename, tostring(texture_size), crypt.sha1(file.load(filename) or "") }
+	if mipmap and mipmap > 0 then
+		-- sprites are aligned to mipmap blocks
+		h[#h+1] = "mipmap " .. mipmap
+	end
+	if premultiply then
+		h[#h+1] = "premultiply"
+	end
+	if compress then
+		-- pages are the compressed mipmap chains
+		h[#h+1] = "compress " .. compress
+	end
+	local visited = {}
+	for _, item in ipairs(desc) do
+		local fname = item.filename
+		if not visited[fname] then
+			visited[fname] = true
+			h[#h+1] = fname
+			h[#h+1] = crypt.sha1(content(filecache, fname))
+		end
+	end
+	local rects, texture_n = bank:dump()
+	h[#h+1] = crypt.sha1(rects)
+	h[#h+1] = tostring(texture_n)
+	return crypt.sha1(table.concat(h, "\n"))
+end
+
+local function encode_desc(desc)
+	local r = { string.pack("<I4", #desc) }
+	for _, item in ipairs(desc) do
+		if type(item.name) ~= "string" then
+			return
+		end
+		local n = #item
+		r[#r+1] = string.pack("<s2s2I4", item.name, item.filename, n)
+		if n == 0 then
+			r[#r+1] = string.pack(SPRITE, item.cx, item.cy, item.cw, item.ch, item.x, item.y)
+		else
+			for i = 1, n do
+				local s = item[i]
+				r[#r+1] = string.pack(SPRITE, s.cx, s.cy, s.cw, s.ch, s.x, s.y)
+			end
+		end
+	end
+	return table.concat(r)
+end
+
+local function decode_desc(data)
+	local desc = {}
+	local n, pos = string.unpack("<I4", data)
+	for i = 1, n do
+		local name, filename, count
+		name, filename, count, pos = string.unpack("<s2s2I4", data, pos)
+		local item = { name = name, filename = filename }
+		if count == 0 then
+			item.cx, item.cy, item.cw, item.ch, item.x, item.y, pos = string.unpack(SPRITE, data, pos)
+		else
+			for j = 1, count do
+				local s = { filename = filename }
+				s.cx, s.cy, s.cw, s.ch, s.x, s.y, pos = string.unpack(SPRITE, data, pos)
+				item[j] = s
+			end
+		end
+		desc[i] = item
+	end
+	return desc
+end
+
+local function decode(data, key)
+	local magic, version, ckey, texture_n, from, npages, pos = string.unpack(HEADER, data)
+	if magic ~= MAGIC or version ~= VERSION or ckey ~= key then
+		return
+	end
+	local desc, rects
+	desc, rects, pos = string.unpack("<s4s4", data, pos)
+	local pages = { from = from }
+	for i = 1, npages do
+		local page
+		page, pos = string.unpack("<s4", data, pos)
+		pages[i] = zip.uncompress(page)
+	end
+	return {
+		desc = decode_desc(desc),
+		rects = rects,
+		texture_n = texture_n,
+		pages = pages,
+	}
+end
+
+function M.load(cachefile, key)
+	-- cache file is always on local disk, don't use soluna.file (it may be redirected into zip)
+	local f = io.open(cachefile, "rb")
+	if f == nil then
+		return
+	end
+	local data = f:read "a"
+	f:close()
+	local ok, r = pcall(decode, data, key)
+	if ok then
+		return r
+	end
+end
+
+-- pages : lightuserdata of each page, page_size bytes, or strings of compressed pages
+function M.save(cachefile, key, desc, bank, from, pages, page_size, level)
+	local d = encode_desc(desc)
+	if d == nil then
+		return
+	end
+	local f = io.open(cachefile, "wb")
+	if f == nil then
+		return
+	end
+	local rects, texture_n = bank:dump()
+	f:write(string.pack(HEADER, MAGIC, VERSION, key, texture_n, from, #pages), string.pack("<s4s4", d, rects))
+	for i = 1, #pages do
+		local p = pages[i]
+		local page
+		if type(p) == "string" then
+			page = zip.compress(p, level)
+		else
+			page = zip.compress(p, page_size, level)
+		end
+		f:write(string.pack("<I4", #page), page)
+	end
+	f:close()
+	return true
+end
+
+return M
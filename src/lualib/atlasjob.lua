@@ -0,0 +1,31 @@
+-- The jobs of texture pages, run by loader (without workers) or loaderworker services.
+-- Each job is job(texture_size, arg), see loader.lua page_jobs
+local image = require "soluna.image"
+local bc = require "soluna.image.bc"
+local table = table
+
+global none
+
+local job = {}
+
+-- arg : one band of a texture, see loader.lua S.blit
+function job.blit(size, arg)
+	image.blit_many(image.canvas(arg.ptr, size, size), arg.list, arg.y0, arg.y1, arg.premultiply, arg.extrude)
+end
+
+-- levels : pointers of the mipmap chain of one texture, see loader.lua S.mipmap
+function job.mipmap(size, levels)
+	image.mipmap(size, levels.premultiply, table.unpack(levels))
+end
+
+-- levels : the same as job.mipmap, returns the BC3 blocks of all levels, see loader.lua S.compress
+function job.compress(size, levels)
+	local r = {}
+	for i = 1, #levels do
+		r[i] = bc.encode(levels[i], size, size)
+		size = size // 2
+	end
+	return table.concat(r)
+end
+
+return job
@@ -2,6 +2,8 @@ local yoga = require "soluna.layout.yoga"
 local datalist = require "soluna.datalist"
 local file = require "soluna.file"
 local table = table
+local string = string
+local math = math
 
 global next, error, assert, type, setmetatable, pairs
 
@@ -90,6 +92,10 @@ do
 		return content, attr
 	end
 	
+	local function is_object(attr)
+		return attr.image or attr.text or attr.background or attr.region
+	end
+
 	local function new_element(doc, cobj, attr)
 		yoga.node_set(cobj, attr)
 		local id = attr.id
@@ -102,14 +108,16 @@ do
 			doc._yoga[id] = cobj
 		end
 		
-		if attr.image or attr.text or attr.background or attr.region then
+		if is_object(attr) then
 			local obj = {}
 			for k,v in pairs(attr) do
 				obj[k] = v
 			end
 			doc._yoga[obj] = cobj
 			doc._yoga[cobj] = obj
-			doc._list[#doc._list + 1] = obj
+			local index = #doc._list + 1
+			doc._list[index] = obj
+			yoga.node_index(cobj, index)
 		end
 	end
 
@@ -125,10 +133,114 @@ do
 		end
 	end
 
+	-- Keep in sync with luayoga.c
+	local MAGIC <const> = "SOLAYOUT"
+	local VERSION <const> = 1
+	local FLAG_ID <const> = 1
+	local FLAG_OBJECT <const> = 2
+	local VALUE_STRING <const> = 0
+	local VALUE_NUMBER <const> = 1
+	local VALUE_INTEGER <const> = 2
+	local VALUE_BOOLEAN <const> = 3
+
+	local function pack_value(k, v)
+		local t = type(v)
+		if t == "string" then
+			return string.pack("<s2Bs4", k, VALUE_STRING, v)
+		elseif t == "boolean" then
+			return string.pack("<s2BB", k, VALUE_BOOLEAN, v and 1 or 0)
+		elseif math.type(v) == "integer" then
+			return string.pack("<s2Bj", k, VALUE_INTEGER, v)
+		elseif t == "number" then
+			return string.pack("<s2Bd", k, VALUE_NUMBER, v)
+		end
+		error ("Can't compile attribute " .. k)
+	end
+
+	local function compile_node(r, v, scripts)
+		local content, attr = parse_node(v, scripts)
+		-- let yoga parse the attributes once, and keep the typed style
+		local cobj = yoga.node_new()
+		yoga.node_set(cobj, attr)
+		local style = yoga.node_style(cobj, attr.flex ~= nil)
+		yoga.node_free(cobj)
+		local id = attr.id
+		local object = is_object(attr)
+		local flags = 0
+		if id then
+			assert(type(id) == "string", "Can't compile non-string id")
+			flags = flags | FLAG_ID
+		end
+		if object then
+			flags = flags | FLAG_OBJECT
+		end
+		r[#r+1] = string.pack("<I4s2B", content and #content // 2 or 0, style, flags)
+		if id then
+			r[#r+1] = string.pack("<s2", id)
+		end
+		if object then
+			-- sort the keys, the compiled data should not depend on the order of pairs
+			local keys = {}
+			for k in pairs(attr) do
+				keys[#keys+1] = k
+			end
+			table.sort(keys)
+			local n = #r
+			r[n + 1] = string.pack("<I2", #keys)
+			for i = 1, #keys do
+				local k = keys[i]
+				r[n + 1 + i] = pack_value(k, attr[k])
+			end
+		end
+		if content then
+			for i = 1, #content, 2 do
+				compile_node(r, content[i+1], scripts)
+			end
+		end
+	end
+
+	-- Compile a layout document into binary data, which can be loaded by layout.load (from a file) without parsing.
+	-- Dynamic children (scripts) are resolved at compile time.
+	function layout.compile(filename_or_list, scripts)
+		local list = filename_or_list
+		if type(list) == "string" then
+			list = datalist.parse_list(file.load(list))
+		end
+		local r = { MAGIC, string.pack("<I4", VERSION) }
+		compile_node(r, list, scripts)
+		return table.concat(r)
+	end
+
+	local function load_compiled(data)
+		local root, list, cobjs, ids = yoga.node_load(data)
+		local doc = {
+			_root = root,
+			_yoga = {},
+			_list = list,
+			_element = {},
+		}
+		local _yoga = doc._yoga
+		for i = 1, #list do
+			local obj = list[i]
+			local cobj = cobjs[i]
+			_yoga[obj] = cobj
+			_yoga[cobj] = obj
+		end
+		for id, cobj in pairs(ids) do
+			doc._element[id] = setmetatable({ _document = doc, _id = id }, element)
+			_yoga[id] = cobj
+		end
+		return setmetatable(doc, document)
+	end
+
 	function layout.load(filename_or_list, scripts)
 		local list
 		if type(filename_or_list) == "string" then
-			list = datalist.parse_list(file.load(filename_or_list))
+			local source = file.load(filename_or_list)
+			if source and source:sub(1, #MAGIC) == MAGIC then
+				return load_compiled(source)
+			end
+			list = datalist.parse_list(source)
 		else
 			list = filename_or_list
 		end
@@ -149,18 +261,12 @@ do
 	end
 	
 	function layout.calc(doc)
-		yoga.node_calc(doc._root)
+		local root = doc._root
+		yoga.node_calc(root)
 		local list = doc._list
-		local yogaobj = doc._yoga
-		for i = 1, #list do
-			local obj = list[i]
-			local cobj = yogaobj[obj]
-			do local _ENV = obj
-				global x, y, w, h
-				x,y,w,h = yoga.node_get(cobj)
-			end
-		end
-		local _,_,w,h = yoga.node_get(doc._root)
+		-- only the items with new layout are updated
+		list.changed = yoga.node_export(root, list)
+		local _,_,w,h = yoga.node_get(root)
 		list.width = w
 		list.height = h
 		return list
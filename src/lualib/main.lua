@@ -5,6 +5,9 @@ global load, require, assert, select, error, tostring, print, type
 
 local init_func_temp = [=[
 	local name, service_path = ...
+	local trace = require "soluna.trace"
+	trace.name(name)
+	trace.mark "service_init"
 	local embedsource = require "soluna.embedsource"
 	local file = require "soluna.file"
 	package.path = [[${lua_path}]]
@@ -78,6 +81,9 @@ local function start(config)
 		},
 	})
 
+	local trace = require "soluna.trace"
+	trace.name "app"
+	trace.begin "ltask_bootstrap"
 	boot.init_socket()
 	local bootstrap = load(embedsource.runtime.bootstrap(), "@3rd/ltask/lualib/bootstrap.lua")()
 	local core = config.core or {}
@@ -90,6 +96,7 @@ local function start(config)
 	}
 	-- wait for INIT_EVENT, see start.lua
 	boot.mainthread_wait()
+	trace.finish "ltask_bootstrap"
 	local sender, sender_ud = bootstrap.external_sender(ctx)
 	local c_sendmessage = require "soluna.app".sendmessage
 	local function send_message(...)
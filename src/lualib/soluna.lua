@@ -2,7 +2,7 @@ local ltask = require "ltask"
 local app = require "soluna.app"
 local mqueue = require "ltask.mqueue"
 
-global require, error, string, assert, package, setmetatable, tostring
+global require, error, string, table, assert, package, setmetatable, tostring
 
 local soluna = {
 	platform = app.platform
@@ -80,6 +80,31 @@ function soluna.load_sprites(filename)
 	return sprites
 end
 
+function soluna.unload_sprites(bundle)
+	local render = ltask.uniqueservice "render"
+	ltask.call(render, "unload_sprites", bundle)
+end
+
+local layer_index = {}
+local layer_mt = { __index = layer_index }
+
+-- content : a batch from soluna.spritemgr.newbatch(), it's copied and drawn into the layer in this frame, an empty batch clears the layer
+function layer_index:update(content)
+	local render = ltask.uniqueservice "render"
+	ltask.send(render, "layer_update", self.handle, content:transient())
+end
+
+function layer_index:release()
+	local render = ltask.uniqueservice "render"
+	ltask.call(render, "layer_release", self.handle)
+end
+
+function soluna.layer(w, h)
+	local render = ltask.uniqueservice "render"
+	local id, handle = ltask.call(render, "layer_new", w, h)
+	return setmetatable({ id = id, handle = handle }, layer_mt)
+end
+
 local audio_service
 
 local voice_index = {}
@@ -117,6 +142,72 @@ function voice_index:tell()
 	return ltask.call(audio_service, "voice_tell", self.id)
 end
 
+-- Keep in sync with AUDIO_OP_* in audio.c
+local AUDIO_OP_VOLUME <const> = 1
+local AUDIO_OP_PAN <const> = 2
+local AUDIO_OP_PITCH <const> = 3
+local AUDIO_OP_LOOP <const> = 4
+local AUDIO_OP_SEEK <const> = 5
+local AUDIO_OP_STOP <const> = 6
+local AUDIO_COMMAND <const> = "<I4I4f"
+
+local batch_index = {}
+local batch_mt = { __index = batch_index }
+
+local function batch_post(self, voice, op, value)
+	local n = self.n + 1
+	self.n = n
+	self[n] = string.pack(AUDIO_COMMAND, voice.id, op, value)
+end
+
+function batch_index:set_volume(voice, volume)
+	batch_post(self, voice, AUDIO_OP_VOLUME, volume)
+end
+
+function batch_index:set_pan(voice, pan)
+	batch_post(self, voice, AUDIO_OP_PAN, pan)
+end
+
+function batch_index:set_pitch(voice, pitch)
+	batch_post(self, voice, AUDIO_OP_PITCH, pitch)
+end
+
+function batch_index:set_loop(voice, loop)
+	batch_post(self, voice, AUDIO_OP_LOOP, loop and 1 or 0)
+end
+
+function batch_index:seek(voice, seconds)
+	batch_post(self, voice, AUDIO_OP_SEEK, seconds)
+end
+
+function batch_index:stop(voice, fade_seconds)
+	batch_post(self, voice, AUDIO_OP_STOP, fade_seconds or 0)
+end
+
+function batch_index:flush()
+	local n = self.n
+	if n == 0 then
+		return
+	end
+	ltask.send(audio_service, "voice_commands", table.concat(self, "", 1, n))
+	for i = 1, n do
+		self[i] = nil
+	end
+	self.n = 0
+end
+
+function soluna.audio_batch()
+	return setmetatable({ n = 0 }, batch_mt)
+end
+
+function soluna.voice_query(voice_list)
+	local ids = {}
+	for i = 1, #voice_list do
+		ids[i] = voice_list[i].id
+	end
+	return ltask.call(audio_service, "voice_query", ids)
+end
+
 local bus_index = {}
 local bus_mt = { __index = bus_index }
 
@@ -92,17 +92,17 @@ local function crop(item, filecache)
 	end
 end
 
-local function load_list(filecache, v, path)
+local function resolve_filename(v, path)
 	for idx, item in ipairs(v) do
 		local fname = item.filename or "Need filename for item " .. idx
 		if path then
 			item.filename = path .. fname
 		end
-		crop(item, filecache)
 	end
 end
 
-function M.load(filecache, filename, path)
+-- parse bundle and resolve filenames, without loading images
+function M.parse(filename, path)
 	local v
 	if type(filename) == "table" then
 		v = filename
@@ -110,10 +110,21 @@ function M.load(filecache, filename, path)
 		path = path or filename:match "(.*[/\\])[^/\\]+$"
 		v = load_bundle(filename)
 	end
-	load_list(filecache, v, path)
+	resolve_filename(v, path)
+	return v
+end
+
+function M.crop(filecache, v)
+	for _, item in ipairs(v) do
+		crop(item, filecache)
+	end
 	return v
 end
 
+function M.load(filecache, filename, path)
+	return M.crop(filecache, M.parse(filename, path))
+end
+
 function M.loadimage(filecache, filename)
 	local content = file.load(filename)
 	if not content then
@@ -1,6 +1,7 @@
+local ltask = require "ltask"
 local table = table
 
-global setmetatable
+global setmetatable, pcall, error
 
 local util = {}
 
@@ -21,4 +22,29 @@ function util.func_chain()
 	return setmetatable({}, func_chain)
 end
 
+-- Returns lock(f, ...) : call f exclusively in the service. f may yield (ltask.call, ltask.wait),
+-- the other requests calling lock wait in order until it returns or raises.
+function util.lock()
+	local waiting
+	return function(f, ...)
+		if waiting then
+			waiting[#waiting+1] = ltask.current_token()
+			ltask.wait()
+		else
+			waiting = {}
+		end
+		local r = table.pack(pcall(f, ...))
+		local token = table.remove(waiting, 1)
+		if token then
+			ltask.wakeup(token)
+		else
+			waiting = nil
+		end
+		if not r[1] then
+			error(r[2], 0)
+		end
+		return table.unpack(r, 2, r.n)
+	end
+end
+
 return util
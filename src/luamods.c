@@ -29,12 +29,16 @@ int luaopen_gamepad_device(lua_State *L);
 int luaopen_gamepad(lua_State *L);
 int luaopen_localfs(lua_State *L);
 int luaopen_image_sdf(lua_State *L);
+int luaopen_image_bc(lua_State *L);
 int luaopen_layout_yoga(lua_State *L);
 int luaopen_url(lua_State *L);
 int luaopen_skynet_crypt(lua_State *L);
 int luaopen_zip(lua_State *L);
 int luaopen_extlua(lua_State *L);
 int luaopen_soluna_audio(lua_State *L);
+int luaopen_soluna_trace(lua_State *L);
+int luaopen_soluna_capture(lua_State *L);
+int luaopen_soluna_arena(lua_State *L);
 
 void soluna_embed(lua_State* L) {
     static const luaL_Reg modules[] = {
@@ -65,12 +69,16 @@ void soluna_embed(lua_State* L) {
 		{ "soluna.gamepad.device", luaopen_gamepad_device },
 		{ "soluna.lfs", luaopen_localfs },
 		{ "soluna.image.sdf", luaopen_image_sdf },
+		{ "soluna.image.bc", luaopen_image_bc },
 		{ "soluna.layout.yoga", luaopen_layout_yoga },
 		{ "soluna.url", luaopen_url },
 		{ "soluna.crypt", luaopen_skynet_crypt },
 		{ "soluna.zip", luaopen_zip },
 		{ "soluna.extlua", luaopen_extlua },
 		{ "soluna.audio", luaopen_soluna_audio },
+		{ "soluna.trace", luaopen_soluna_trace },
+		{ "soluna.capture", luaopen_soluna_capture },
+		{ "soluna.arena", luaopen_soluna_arena },
 		{ NULL, NULL },
     };
 
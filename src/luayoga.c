@@ -4,6 +4,8 @@
 #include <lauxlib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <assert.h>
 #include "yoga/Yoga.h"
 
 #define FlexDirection 1
@@ -109,6 +111,62 @@ lnodeGet(lua_State *L) {
 	return 4;
 }
 
+// The context of a node is its index in the result list (see layout.lua), 0 for none.
+static int
+lnodeIndex(lua_State *L) {
+	YGNodeRef node = lua_touserdata(L, 1);
+	lua_Integer index = luaL_checkinteger(L, 2);
+	YGNodeSetContext(node, (void *)(intptr_t)index);
+	return 0;
+}
+
+static void
+set_field(lua_State *L, const char *key, float v) {
+	lua_pushnumber(L, v);
+	lua_setfield(L, -2, key);
+}
+
+static int
+export_node(lua_State *L, YGNodeRef node, float x, float y, int moved) {
+	int changed = 0;
+	if (YGNodeGetHasNewLayout(node)) {
+		YGNodeSetHasNewLayout(node, false);
+		moved = 1;
+	}
+	x += YGNodeLayoutGetLeft(node);
+	y += YGNodeLayoutGetTop(node);
+	if (moved) {
+		int index = (int)(intptr_t)YGNodeGetContext(node);
+		if (index > 0 && lua_rawgeti(L, 2, index) == LUA_TTABLE) {
+			set_field(L, "x", x);
+			set_field(L, "y", y);
+			set_field(L, "w", YGNodeLayoutGetWidth(node));
+			set_field(L, "h", YGNodeLayoutGetHeight(node));
+			++changed;
+		}
+		lua_pop(L, 1);
+	}
+	size_t n = YGNodeGetChildCount(node);
+	size_t i;
+	for (i=0;i<n;i++) {
+		// a child moves with its parent even if its own (relative) layout is not new
+		changed += export_node(L, YGNodeGetChild(node, i), x, y, moved);
+	}
+	return changed;
+}
+
+// 1: root, 2: result list
+// Write x/y/w/h into list[index] for the nodes which have new layout after node_calc (or whose ancestor has),
+// and clear the hasNewLayout flags. Returns the number of updated items.
+static int
+lnodeExport(lua_State *L) {
+	YGNodeRef root = lua_touserdata(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int changed = export_node(L, root, 0, 0, 0);
+	lua_pushinteger(L, changed);
+	return 1;
+}
+
 typedef void (*setfunc)(lua_State *L, YGNodeRef node);
 
 static inline int
@@ -148,76 +206,82 @@ setNumber(lua_State *L, YGNodeRef node, const struct set_number *setter) {
 	}
 }
 
+static const struct set_number width_setter = {
+	YGNodeStyleSetWidth,
+	YGNodeStyleSetWidthPercent,
+	YGNodeStyleSetWidthAuto,
+	YGNodeStyleSetWidthMaxContent,
+	YGNodeStyleSetWidthFitContent,
+};
+
 static void
 lsetWidth(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetWidth,
-		YGNodeStyleSetWidthPercent,
-		YGNodeStyleSetWidthAuto,
-		YGNodeStyleSetWidthMaxContent,
-		YGNodeStyleSetWidthFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &width_setter);
 }
 
+static const struct set_number min_width_setter = {
+	YGNodeStyleSetMinWidth,
+	YGNodeStyleSetMinWidthPercent,
+	NULL,
+	YGNodeStyleSetMinWidthMaxContent,
+	YGNodeStyleSetMinWidthFitContent,
+};
+
 static void
 lsetMinWidth(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetMinWidth,
-		YGNodeStyleSetMinWidthPercent,
-		NULL,
-		YGNodeStyleSetMinWidthMaxContent,
-		YGNodeStyleSetMinWidthFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &min_width_setter);
 }
 
+static const struct set_number max_width_setter = {
+	YGNodeStyleSetMaxWidth,
+	YGNodeStyleSetMaxWidthPercent,
+	NULL,
+	YGNodeStyleSetMaxWidthMaxContent,
+	YGNodeStyleSetMaxWidthFitContent,
+};
+
 static void
 lsetMaxWidth(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetMaxWidth,
-		YGNodeStyleSetMaxWidthPercent,
-		NULL,
-		YGNodeStyleSetMaxWidthMaxContent,
-		YGNodeStyleSetMaxWidthFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &max_width_setter);
 }
 
+static const struct set_number height_setter = {
+	YGNodeStyleSetHeight,
+	YGNodeStyleSetHeightPercent,
+	YGNodeStyleSetHeightAuto,
+	YGNodeStyleSetHeightMaxContent,
+	YGNodeStyleSetHeightFitContent,
+};
+
 static void
 lsetHeight(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetHeight,
-		YGNodeStyleSetHeightPercent,
-		YGNodeStyleSetHeightAuto,
-		YGNodeStyleSetHeightMaxContent,
-		YGNodeStyleSetHeightFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &height_setter);
 }
 
+static const struct set_number min_height_setter = {
+	YGNodeStyleSetMinHeight,
+	YGNodeStyleSetMinHeightPercent,
+	NULL,
+	YGNodeStyleSetMinHeightMaxContent,
+	YGNodeStyleSetMinHeightFitContent,
+};
+
 static void
 lsetMinHeight(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetMinHeight,
-		YGNodeStyleSetMinHeightPercent,
-		NULL,
-		YGNodeStyleSetMinHeightMaxContent,
-		YGNodeStyleSetMinHeightFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &min_height_setter);
 }
 
+static const struct set_number max_height_setter = {
+	YGNodeStyleSetMaxHeight,
+	YGNodeStyleSetMaxHeightPercent,
+	NULL,
+	YGNodeStyleSetMaxHeightMaxContent,
+	YGNodeStyleSetMaxHeightFitContent,
+};
+
 static void
 lsetMaxHeight(lua_State *L, YGNodeRef node) {
-	static const struct set_number setter = {
-		YGNodeStyleSetMaxHeight,
-		YGNodeStyleSetMaxHeightPercent,
-		NULL,
-		YGNodeStyleSetMaxHeightMaxContent,
-		YGNodeStyleSetMaxHeightFitContent,
-	};
-	setNumber(L, node, &setter);
+	setNumber(L, node, &max_height_setter);
 }
 
 static const char *
@@ -343,17 +407,18 @@ getNumber(lua_State *L, const char *v, float *num) {
 	return endptr;
 }
 
+static const struct set_number flex_basis_setter = {
+	YGNodeStyleSetFlexBasis,
+	YGNodeStyleSetFlexBasisPercent,
+	YGNodeStyleSetFlexBasisAuto,
+	YGNodeStyleSetFlexBasisMaxContent,
+	YGNodeStyleSetFlexBasisFitContent,
+};
+
 static void
 setFlexBasis(lua_State *L, YGNodeRef node, const char *v) {
-	static const struct set_number setter = {
-		YGNodeStyleSetFlexBasis,
-		YGNodeStyleSetFlexBasisPercent,
-		YGNodeStyleSetFlexBasisAuto,
-		YGNodeStyleSetFlexBasisMaxContent,
-		YGNodeStyleSetFlexBasisFitContent,
-	};
 	v = skip_whitespace(v);
-	setNumberString(L, node, v, &setter);
+	setNumberString(L, node, v, &flex_basis_setter);
 }
 
 static void
@@ -408,43 +473,47 @@ lsetFlex(lua_State *L, YGNodeRef node) {
 	}
 }
 
+static const struct set_edge_number margin_setter = {
+	YGNodeStyleSetMargin,
+	YGNodeStyleSetMarginPercent,
+	YGNodeStyleSetMarginAuto,
+};
+
 static void
 lsetMargin(lua_State *L, YGNodeRef node) {
-	static const struct set_edge_number setter = {
-		YGNodeStyleSetMargin,
-		YGNodeStyleSetMarginPercent,
-		YGNodeStyleSetMarginAuto,
-	};
-	setFourNumber(L, node, &setter);
+	setFourNumber(L, node, &margin_setter);
 }
 
+static const struct set_edge_number padding_setter = {
+	YGNodeStyleSetPadding,
+	YGNodeStyleSetPaddingPercent,
+	NULL,
+};
+
 static void
 lsetPadding(lua_State *L, YGNodeRef node) {
-	static const struct set_edge_number setter = {
-		YGNodeStyleSetPadding,
-		YGNodeStyleSetPaddingPercent,
-		NULL,
-	};
-	setFourNumber(L, node, &setter);
+	setFourNumber(L, node, &padding_setter);
 }
 
+static const struct set_edge_number border_setter = {
+	YGNodeStyleSetBorder,
+	NULL,
+	NULL,
+};
+
 static void
 lsetBorder(lua_State *L, YGNodeRef node) {
-	static const struct set_edge_number setter = {
-		YGNodeStyleSetBorder,
-		NULL,
-		NULL,
-	};
-	setFourNumber(L, node, &setter);
+	setFourNumber(L, node, &border_setter);
 }
 
+static const struct set_two_number gap_setter = {
+	YGNodeStyleSetGap,
+	YGNodeStyleSetGapPercent,
+};
+
 static void
 lsetGap(lua_State *L, YGNodeRef node) {
-	static const struct set_two_number setter = {
-		YGNodeStyleSetGap,
-		YGNodeStyleSetGapPercent,
-	};
-	setTwoNumber(L, node, &setter);
+	setTwoNumber(L, node, &gap_setter);
 }
 
 static int
@@ -512,19 +581,21 @@ lsetPosition(lua_State *L, YGNodeRef node) {
 	YGNodeStyleSetPositionType(node, getEnum(L, PositionType, "position"));
 }
 
+static const struct set_edge_number position_setter = {
+	YGNodeStyleSetPosition,
+	YGNodeStyleSetPositionPercent,
+	YGNodeStyleSetPositionAuto,
+};
+
 static void
 setPosition(lua_State *L, YGNodeRef node, YGEdge edge) {
-	static const struct set_edge_number setter = {
-		YGNodeStyleSetPosition,
-		YGNodeStyleSetPositionPercent,
-		YGNodeStyleSetPositionAuto,
-	};
+	const struct set_edge_number *setter = &position_setter;
 	if (lua_type(L, -1) == LUA_TNUMBER) {
 		float v = luaL_checknumber(L, -1);
-		setter.set(node, edge, v);
+		setter->set(node, edge, v);
 	} else {
 		const char *v = luaL_checkstring(L, -1);
-		setEdgeNumber(L, node, edge, v, &setter);
+		setEdgeNumber(L, node, edge, v, setter);
 	}
 }
 
@@ -599,6 +670,425 @@ lnodeSet(lua_State *L) {
 	return 0;
 }
 
+// Precompiled layout : node_style() snapshots the parsed style of a node as typed records,
+// node_load() rebuilds a whole tree from the records without parsing any attribute string.
+
+enum style_prop {
+	PROP_WIDTH = 1,
+	PROP_MIN_WIDTH,
+	PROP_MAX_WIDTH,
+	PROP_HEIGHT,
+	PROP_MIN_HEIGHT,
+	PROP_MAX_HEIGHT,
+	PROP_FLEX_BASIS,
+	PROP_MARGIN,
+	PROP_PADDING,
+	PROP_POSITION,
+	PROP_BORDER,
+	PROP_GAP,
+	PROP_FLEX,
+	PROP_FLEX_GROW,
+	PROP_FLEX_SHRINK,
+	PROP_ASPECT_RATIO,
+	PROP_DIRECTION,
+	PROP_JUSTIFY,
+	PROP_ALIGN_ITEMS,
+	PROP_ALIGN_CONTENT,
+	PROP_ALIGN_SELF,
+	PROP_WRAP,
+	PROP_DISPLAY,
+	PROP_POSITION_TYPE,
+};
+
+struct style_record {
+	uint8_t prop;
+	uint8_t edge;	// YGEdge or YGGutter
+	uint8_t unit;	// YGUnit
+	float value;
+};
+
+// A style record is serialized in 8 bytes : prop, edge, unit, padding, value (float in little endian)
+#define STYLE_RECORD_SIZE 8
+// number, edge (margin, padding, position, border), gap, float, enum properties
+#define STYLE_RECORD_MAX (7 + 4 * 9 + 3 + 4 + 8)
+
+static const struct {
+	YGValue (*get)(YGNodeConstRef node);
+	const struct set_number *setter;
+} number_prop[] = {
+	[PROP_WIDTH] = { YGNodeStyleGetWidth, &width_setter },
+	[PROP_MIN_WIDTH] = { YGNodeStyleGetMinWidth, &min_width_setter },
+	[PROP_MAX_WIDTH] = { YGNodeStyleGetMaxWidth, &max_width_setter },
+	[PROP_HEIGHT] = { YGNodeStyleGetHeight, &height_setter },
+	[PROP_MIN_HEIGHT] = { YGNodeStyleGetMinHeight, &min_height_setter },
+	[PROP_MAX_HEIGHT] = { YGNodeStyleGetMaxHeight, &max_height_setter },
+	[PROP_FLEX_BASIS] = { YGNodeStyleGetFlexBasis, &flex_basis_setter },
+};
+
+static const struct {
+	YGValue (*get)(YGNodeConstRef node, YGEdge edge);
+	const struct set_edge_number *setter;
+} edge_prop[] = {
+	[PROP_MARGIN - PROP_MARGIN] = { YGNodeStyleGetMargin, &margin_setter },
+	[PROP_PADDING - PROP_MARGIN] = { YGNodeStyleGetPadding, &padding_setter },
+	[PROP_POSITION - PROP_MARGIN] = { YGNodeStyleGetPosition, &position_setter },
+};
+
+static const struct {
+	float (*get)(YGNodeConstRef node);
+	void (*set)(YGNodeRef node, float v);
+} float_prop[] = {
+	[PROP_FLEX - PROP_FLEX] = { YGNodeStyleGetFlex, YGNodeStyleSetFlex },
+	[PROP_FLEX_GROW - PROP_FLEX] = { YGNodeStyleGetFlexGrow, YGNodeStyleSetFlexGrow },
+	[PROP_FLEX_SHRINK - PROP_FLEX] = { YGNodeStyleGetFlexShrink, YGNodeStyleSetFlexShrink },
+	[PROP_ASPECT_RATIO - PROP_FLEX] = { YGNodeStyleGetAspectRatio, YGNodeStyleSetAspectRatio },
+};
+
+static int
+get_enum_prop(YGNodeConstRef node, int prop) {
+	switch (prop) {
+	case PROP_DIRECTION: return YGNodeStyleGetFlexDirection(node);
+	case PROP_JUSTIFY: return YGNodeStyleGetJustifyContent(node);
+	case PROP_ALIGN_ITEMS: return YGNodeStyleGetAlignItems(node);
+	case PROP_ALIGN_CONTENT: return YGNodeStyleGetAlignContent(node);
+	case PROP_ALIGN_SELF: return YGNodeStyleGetAlignSelf(node);
+	case PROP_WRAP: return YGNodeStyleGetFlexWrap(node);
+	case PROP_DISPLAY: return YGNodeStyleGetDisplay(node);
+	case PROP_POSITION_TYPE: return YGNodeStyleGetPositionType(node);
+	}
+	return 0;
+}
+
+static int
+set_enum_prop(YGNodeRef node, int prop, int v) {
+	switch (prop) {
+	case PROP_DIRECTION: YGNodeStyleSetFlexDirection(node, v); break;
+	case PROP_JUSTIFY: YGNodeStyleSetJustifyContent(node, v); break;
+	case PROP_ALIGN_ITEMS: YGNodeStyleSetAlignItems(node, v); break;
+	case PROP_ALIGN_CONTENT: YGNodeStyleSetAlignContent(node, v); break;
+	case PROP_ALIGN_SELF: YGNodeStyleSetAlignSelf(node, v); break;
+	case PROP_WRAP: YGNodeStyleSetFlexWrap(node, v); break;
+	case PROP_DISPLAY: YGNodeStyleSetDisplay(node, v); break;
+	case PROP_POSITION_TYPE: YGNodeStyleSetPositionType(node, v); break;
+	default: return 0;
+	}
+	return 1;
+}
+
+static inline int
+same_value(YGValue a, YGValue b) {
+	if (a.unit != b.unit)
+		return 0;
+	return (a.unit != YGUnitPoint && a.unit != YGUnitPercent) || a.value == b.value;
+}
+
+static inline int
+same_float(float a, float b) {
+	return (YGFloatIsUndefined(a) && YGFloatIsUndefined(b)) || a == b;
+}
+
+struct style_buffer {
+	int n;
+	uint8_t data[STYLE_RECORD_MAX * STYLE_RECORD_SIZE];
+};
+
+static void
+add_record(struct style_buffer *b, int prop, int edge, int unit, float value) {
+	assert(b->n < STYLE_RECORD_MAX);
+	uint8_t *p = b->data + b->n++ * STYLE_RECORD_SIZE;
+	uint32_t v;
+	memcpy(&v, &value, sizeof(v));
+	p[0] = prop;
+	p[1] = edge;
+	p[2] = unit;
+	p[3] = 0;
+	p[4] = v & 0xff;
+	p[5] = (v >> 8) & 0xff;
+	p[6] = (v >> 16) & 0xff;
+	p[7] = v >> 24;
+}
+
+static void
+decode_record(const uint8_t *p, struct style_record *r) {
+	uint32_t v = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+	r->prop = p[0];
+	r->edge = p[1];
+	r->unit = p[2];
+	memcpy(&r->value, &v, sizeof(v));
+}
+
+// Returns the style of the node as a string of style records, only the values differ from a new node.
+// 2: true if the attribute flex is set. The getters of flexGrow/flexShrink can't tell an explicit 0 from unset,
+// and flex sets either flex alone or both flexGrow and flexShrink, so flex stays undefined when they are set.
+static int
+lnodeStyle(lua_State *L) {
+	YGNodeRef node = lua_touserdata(L, 1);
+	int grow_shrink_set = lua_toboolean(L, 2) && YGFloatIsUndefined(YGNodeStyleGetFlex(node));
+	// the records are collected in C, nothing raises an error before def is freed
+	struct style_buffer sb;
+	struct style_buffer *b = &sb;
+	b->n = 0;
+	YGNodeRef def = YGNodeNew();
+	int prop, edge;
+	for (prop = PROP_WIDTH; prop <= PROP_FLEX_BASIS; prop++) {
+		YGValue v = number_prop[prop].get(node);
+		if (!same_value(v, number_prop[prop].get(def)))
+			add_record(b, prop, 0, v.unit, v.value);
+	}
+	for (prop = PROP_MARGIN; prop <= PROP_POSITION; prop++) {
+		for (edge = YGEdgeLeft; edge <= YGEdgeAll; edge++) {
+			YGValue v = edge_prop[prop - PROP_MARGIN].get(node, edge);
+			if (!same_value(v, edge_prop[prop - PROP_MARGIN].get(def, edge)))
+				add_record(b, prop, edge, v.unit, v.value);
+		}
+	}
+	for (edge = YGEdgeLeft; edge <= YGEdgeAll; edge++) {
+		float v = YGNodeStyleGetBorder(node, edge);
+		if (!same_float(v, YGNodeStyleGetBorder(def, edge)))
+			add_record(b, PROP_BORDER, edge, YGUnitPoint, v);
+	}
+	for (edge = YGGutterColumn; edge <= YGGutterAll; edge++) {
+		YGValue v = YGNodeStyleGetGap(node, edge);
+		if (!same_value(v, YGNodeStyleGetGap(def, edge)))
+			add_record(b, PROP_GAP, edge, v.unit, v.value);
+	}
+	for (prop = PROP_FLEX; prop <= PROP_ASPECT_RATIO; prop++) {
+		float v = float_prop[prop - PROP_FLEX].get(node);
+		int explicit = grow_shrink_set && (prop == PROP_FLEX_GROW || prop == PROP_FLEX_SHRINK);
+		if (explicit || !same_float(v, float_prop[prop - PROP_FLEX].get(def)))
+			add_record(b, prop, 0, YGUnitPoint, v);
+	}
+	for (prop = PROP_DIRECTION; prop <= PROP_POSITION_TYPE; prop++) {
+		int v = get_enum_prop(node, prop);
+		if (v != get_enum_prop(def, prop))
+			add_record(b, prop, 0, YGUnitPoint, (float)v);
+	}
+	YGNodeFree(def);
+	lua_pushlstring(L, (const char *)b->data, b->n * STYLE_RECORD_SIZE);
+	return 1;
+}
+
+static int
+apply_number(YGNodeRef node, const struct set_number *setter, int unit, float v) {
+	switch (unit) {
+	case YGUnitPoint: setter->set(node, v); return 1;
+	case YGUnitPercent: setter->setPercent(node, v); return 1;
+	case YGUnitAuto: if (setter->setAuto == NULL) return 0; setter->setAuto(node); return 1;
+	case YGUnitMaxContent: setter->setMaxContent(node); return 1;
+	case YGUnitFitContent: setter->setFitContent(node); return 1;
+	case YGUnitStretch: if (setter->setStretch == NULL) return 0; setter->setStretch(node); return 1;
+	}
+	return 0;
+}
+
+static int
+apply_edge(YGNodeRef node, const struct set_edge_number *setter, int edge, int unit, float v) {
+	if (edge > YGEdgeAll)
+		return 0;
+	switch (unit) {
+	case YGUnitPoint: setter->set(node, edge, v); return 1;
+	case YGUnitPercent: if (setter->setPercent == NULL) return 0; setter->setPercent(node, edge, v); return 1;
+	case YGUnitAuto: if (setter->setAuto == NULL) return 0; setter->setAuto(node, edge); return 1;
+	}
+	return 0;
+}
+
+static int
+apply_record(YGNodeRef node, const struct style_record *r) {
+	int prop = r->prop;
+	if (prop >= PROP_WIDTH && prop <= PROP_FLEX_BASIS) {
+		return apply_number(node, number_prop[prop].setter, r->unit, r->value);
+	} else if (prop >= PROP_MARGIN && prop <= PROP_POSITION) {
+		return apply_edge(node, edge_prop[prop - PROP_MARGIN].setter, r->edge, r->unit, r->value);
+	} else if (prop == PROP_BORDER) {
+		return apply_edge(node, &border_setter, r->edge, YGUnitPoint, r->value);
+	} else if (prop == PROP_GAP) {
+		if (r->edge > YGGutterAll)
+			return 0;
+		if (r->unit == YGUnitPercent)
+			gap_setter.setPercent(node, r->edge, r->value);
+		else
+			gap_setter.set(node, r->edge, r->value);
+		return 1;
+	} else if (prop >= PROP_FLEX && prop <= PROP_ASPECT_RATIO) {
+		float_prop[prop - PROP_FLEX].set(node, r->value);
+		return 1;
+	}
+	return set_enum_prop(node, prop, (int)r->value);
+}
+
+// Layout data (see layout.compile in lualib/layout.lua), little endian, each node in preorder :
+//	I4 children number, s2 style records, B flags, [s2 id], [I2 n, n * (s2 key, B type, value)]
+#define LAYOUT_MAGIC "SOLAYOUT"
+#define LAYOUT_VERSION 1
+#define LAYOUT_FLAG_ID 1
+#define LAYOUT_FLAG_OBJECT 2
+
+enum layout_value_type {
+	LAYOUT_STRING,
+	LAYOUT_NUMBER,
+	LAYOUT_INTEGER,
+	LAYOUT_BOOLEAN,
+};
+
+struct layout_reader {
+	lua_State *L;
+	const uint8_t *ptr;
+	const uint8_t *end;
+	YGNodeRef root;
+	int list;
+	int cobjs;
+	int ids;
+	int n;
+};
+
+static void
+layout_error(struct layout_reader *rd) {
+	if (rd->root)
+		YGNodeFreeRecursive(rd->root);
+	luaL_error(rd->L, "Invalid layout data");
+}
+
+static const uint8_t *
+layout_read(struct layout_reader *rd, size_t sz) {
+	if ((size_t)(rd->end - rd->ptr) < sz)
+		layout_error(rd);
+	const uint8_t *p = rd->ptr;
+	rd->ptr += sz;
+	return p;
+}
+
+static uint32_t
+read_uint(struct layout_reader *rd, int sz) {
+	const uint8_t *p = layout_read(rd, sz);
+	uint32_t v = 0;
+	int i;
+	for (i=sz-1;i>=0;i--) {
+		v = v << 8 | p[i];
+	}
+	return v;
+}
+
+static uint64_t
+read_uint64(struct layout_reader *rd) {
+	uint64_t lo = read_uint(rd, 4);
+	uint64_t hi = read_uint(rd, 4);
+	return hi << 32 | lo;
+}
+
+static const char *
+read_string(struct layout_reader *rd, int lensz, size_t *sz) {
+	*sz = read_uint(rd, lensz);
+	return (const char *)layout_read(rd, *sz);
+}
+
+static void
+read_value(struct layout_reader *rd) {
+	lua_State *L = rd->L;
+	size_t sz;
+	int type = read_uint(rd, 1);
+	switch (type) {
+	case LAYOUT_STRING: {
+		const char *s = read_string(rd, 4, &sz);
+		lua_pushlstring(L, s, sz);
+		break; }
+	case LAYOUT_NUMBER: {
+		uint64_t v = read_uint64(rd);
+		double d;
+		memcpy(&d, &v, sizeof(d));
+		lua_pushnumber(L, d);
+		break; }
+	case LAYOUT_INTEGER: {
+		int64_t i = (int64_t)read_uint64(rd);
+		lua_pushinteger(L, i);
+		break; }
+	case LAYOUT_BOOLEAN:
+		lua_pushboolean(L, read_uint(rd, 1));
+		break;
+	default:
+		layout_error(rd);
+	}
+}
+
+static void
+read_node(struct layout_reader *rd, YGNodeRef parent) {
+	lua_State *L = rd->L;
+	YGNodeRef node = YGNodeNew();
+	if (parent) {
+		YGNodeInsertChild(parent, node, YGNodeGetChildCount(parent));
+	} else {
+		rd->root = node;
+	}
+	uint32_t children = read_uint(rd, 4);
+	size_t sz;
+	const char *style = read_string(rd, 2, &sz);
+	if (sz % STYLE_RECORD_SIZE != 0)
+		layout_error(rd);
+	size_t i;
+	for (i=0;i<sz;i+=STYLE_RECORD_SIZE) {
+		struct style_record r;
+		decode_record((const uint8_t *)style + i, &r);
+		if (!apply_record(node, &r))
+			layout_error(rd);
+	}
+	int flags = read_uint(rd, 1);
+	if (flags & LAYOUT_FLAG_ID) {
+		const char *id = read_string(rd, 2, &sz);
+		lua_pushlstring(L, id, sz);
+		lua_pushvalue(L, -1);
+		if (lua_rawget(L, rd->ids) != LUA_TNIL) {
+			lua_pop(L, 1);
+			if (rd->root)
+				YGNodeFreeRecursive(rd->root);
+			luaL_error(L, "%s exist", lua_tostring(L, -1));
+		}
+		lua_pop(L, 1);
+		lua_pushlightuserdata(L, node);
+		lua_rawset(L, rd->ids);
+	}
+	if (flags & LAYOUT_FLAG_OBJECT) {
+		int n = read_uint(rd, 2);
+		lua_createtable(L, 0, n);
+		int j;
+		for (j=0;j<n;j++) {
+			const char *key = read_string(rd, 2, &sz);
+			lua_pushlstring(L, key, sz);
+			read_value(rd);
+			lua_rawset(L, -3);
+		}
+		int index = ++rd->n;
+		lua_rawseti(L, rd->list, index);
+		lua_pushlightuserdata(L, node);
+		lua_rawseti(L, rd->cobjs, index);
+		YGNodeSetContext(node, (void *)(intptr_t)index);
+	}
+	for (i=0;i<children;i++) {
+		read_node(rd, node);
+	}
+}
+
+// 1: layout data
+// returns root, list (objects with attributes), cobjs (yoga objects of list), ids (id -> yoga object)
+static int
+lnodeLoad(lua_State *L) {
+	size_t sz;
+	const char *data = luaL_checklstring(L, 1, &sz);
+	lua_settop(L, 1);
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_newtable(L);
+	struct layout_reader rd = { L, (const uint8_t *)data, (const uint8_t *)data + sz, NULL, 2, 3, 4, 0 };
+	const uint8_t *magic = layout_read(&rd, sizeof(LAYOUT_MAGIC) - 1);
+	if (memcmp(magic, LAYOUT_MAGIC, sizeof(LAYOUT_MAGIC) - 1) != 0 || read_uint(&rd, 4) != LAYOUT_VERSION)
+		return luaL_error(L, "Invalid layout data version");
+	read_node(&rd, NULL);
+	if (rd.ptr != rd.end)
+		layout_error(&rd);
+	lua_pushlightuserdata(L, rd.root);
+	lua_replace(L, 1);
+	return 4;
+}
+
 LUAMOD_API int
 luaopen_layout_yoga(lua_State *L) {
 	luaL_checkversion(L);
@@ -608,6 +1098,10 @@ luaopen_layout_yoga(lua_State *L) {
 		{ "node_remove", lnodeRemove },
 		{ "node_calc", lnodeCalc },
 		{ "node_get", lnodeGet },
+		{ "node_index", lnodeIndex },
+		{ "node_export", lnodeExport },
+		{ "node_style", lnodeStyle },
+		{ "node_load", lnodeLoad },
 		{ "node_set", NULL },
 		{ NULL, NULL },
 	};
@@ -22,13 +22,22 @@ external_free(void *ud, void *ptr, size_t osize, size_t nsize) {
 static int
 lcompress(lua_State *L) {
 	size_t sz;
-	const char * src = luaL_checklstring(L, 1, &sz);
+	const char * src;
+	int level_index = 2;
+	if (lua_type(L, 1) == LUA_TLIGHTUSERDATA) {
+		src = (const char *)lua_touserdata(L, 1);
+		sz = (size_t)luaL_checkinteger(L, 2);
+		level_index = 3;
+	} else {
+		src = luaL_checklstring(L, 1, &sz);
+	}
+	int level = luaL_optinteger(L, level_index, Z_DEFAULT_COMPRESSION);
 	uLongf len = compressBound(sz);
 	char * buf = (char *)malloc(len + 1);
 	if (buf == NULL) {
 		return luaL_error(L, "Compress OOM");
 	}
-	if (compress((void *)(buf + 1), &len, (void *)src, sz) != Z_OK) {
+	if (compress2((void *)(buf + 1), &len, (void *)src, sz, level) != Z_OK) {
 		free(buf);
 		return luaL_error(L, "Compress error");
 	}
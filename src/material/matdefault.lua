@@ -10,26 +10,58 @@ local inst_buffer = render.buffer {
 	label = "texquad-instance",
 	size = defmat.instance_size * setting.draw_instance,
 }
+local inst_stream = render.inst_stream {
+	buffer = inst_buffer,
+	size = defmat.instance_size * setting.draw_instance,
+}
 local bindings = render.bindings()
 bindings:vbuffer(0, inst_buffer)
-bindings:view(0, state.views.storage)
+if not setting.sr_direct then
+	bindings:view(0, state.views.storage)
+end
 bindings:sampler(0, state.default_sampler)
 
+-- compact instances read sprite rects from a storage buffer, see texquad_compact
+local rect_buffer
+if setting.sprite_compact then
+	rect_buffer = render.buffer {
+		type = "storage",
+		usage = "dynamic",
+		label = "texquad-rect",
+		size = 16 * setting.sprite_max,
+	}
+	bindings:view(2, render.view { storage = rect_buffer })
+	state.sprite_dirty = true
+end
+
 state.inst = assert(inst_buffer)
+state.inst_stream = inst_stream
 state.bindings = bindings
 state.material = defmat.new {
-	inst_buffer = state.inst,
+	inst_stream = state.inst_stream,
 	bindings = state.bindings,
 	uniform = state.uniform,
 	sr_buffer = state.srbuffer_mem,
 	sprite_bank = ctx.arg.bank_ptr,
-	tmp_buffer = ctx.tmp_buffer,
+	sr_direct = setting.sr_direct,
+	premultiplied = setting.atlas_premultiply,
+	rect_buffer = rect_buffer,
 }
 
 local material = {}
 
 function material.reset()
 	bindings:base(0)
+	inst_stream:reset()
+end
+
+function material.flush()
+	if state.sprite_dirty then
+		state.material:update_rects()
+		state.sprite_dirty = nil
+	end
+	state.sprite_inst_bytes = #inst_stream
+	inst_stream:flush()
 end
 
 function material.submit(ptr, n)
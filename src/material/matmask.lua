@@ -12,6 +12,11 @@ state.mask_inst = render.buffer {
 	size = maskmat.instance_size * ctx.settings.draw_instance,
 }
 
+local mask_stream = render.inst_stream {
+	buffer = state.mask_inst,
+	size = maskmat.instance_size * ctx.settings.draw_instance,
+}
+
 local mask_bindings = render.bindings()
 mask_bindings:vbuffer(0, state.mask_inst)
 mask_bindings:view(0, state.views.storage)
@@ -19,18 +24,22 @@ mask_bindings:sampler(0, state.default_sampler)
 
 state.mask_bindings = mask_bindings
 state.material_mask = maskmat.new {
-	inst_buffer = state.mask_inst,
+	inst_stream = mask_stream,
 	bindings = state.mask_bindings,
 	uniform = state.uniform,
 	sr_buffer = state.srbuffer_mem,
 	sprite_bank = ctx.arg.bank_ptr,
-	tmp_buffer = ctx.tmp_buffer,
 }
 
 local material = {}
 
 function material.reset()
 	mask_bindings:base(0)
+	mask_stream:reset()
+end
+
+function material.flush()
+	mask_stream:flush()
 end
 
 function material.submit(ptr, n)
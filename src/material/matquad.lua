@@ -12,23 +12,35 @@ state.quad_inst = render.buffer {
 	size = quadmat.instance_size * ctx.settings.draw_instance,
 }
 
+local quad_stream = render.inst_stream {
+	buffer = state.quad_inst,
+	size = quadmat.instance_size * ctx.settings.draw_instance,
+}
+
 local quad_bindings = render.bindings()
 quad_bindings:vbuffer(0, state.quad_inst)
-quad_bindings:view(0, state.views.storage)
+if not ctx.settings.sr_direct then
+	quad_bindings:view(0, state.views.storage)
+end
 
 state.quad_bindings = quad_bindings
 state.material_quad = quadmat.new {
-	inst_buffer = state.quad_inst,
+	inst_stream = quad_stream,
 	bindings = state.quad_bindings,
 	uniform = state.uniform,
 	sr_buffer = state.srbuffer_mem,
-	tmp_buffer = ctx.tmp_buffer,
+	sr_direct = ctx.settings.sr_direct,
 }
 
 local material = {}
 
 function material.reset()
 	quad_bindings:base(0)
+	quad_stream:reset()
+end
+
+function material.flush()
+	quad_stream:flush()
 end
 
 function material.submit(ptr, n)
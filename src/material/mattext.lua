@@ -6,39 +6,49 @@ local state = ctx.state
 local setting = ctx.settings
 textmat.set_material_id(ctx.id)
 
-local text_bindings
+-- text instances carry color, so they don't share the default instance buffer
+state.text_inst = render.buffer {
+	type = "vertex",
+	usage = "stream",
+	label = "text-instance",
+	size = textmat.instance_size * setting.draw_instance,
+}
+local text_stream = render.inst_stream {
+	buffer = state.text_inst,
+	size = textmat.instance_size * setting.draw_instance,
+}
 local text_sampler_desc = setting.text_sampler
 if text_sampler_desc then
 	text_sampler_desc.label = text_sampler_desc.label or "text-sampler"
 	state.text_sampler = render.sampler(text_sampler_desc)
-	state.text_inst = render.buffer {
-		type = "vertex",
-		usage = "stream",
-		label = "text-instance",
-		size = textmat.instance_size * setting.draw_instance,
-	}
-	text_bindings = render.bindings()
-	text_bindings:vbuffer(0, state.text_inst)
-	text_bindings:view(0, state.views.storage)
-	text_bindings:sampler(0, state.text_sampler)
 else
-	state.text_inst = state.inst
-	text_bindings = state.bindings
+	state.text_sampler = state.default_sampler
 end
+local text_bindings = render.bindings()
+text_bindings:vbuffer(0, state.text_inst)
+if not setting.sr_direct then
+	text_bindings:view(0, state.views.storage)
+end
+text_bindings:sampler(0, state.text_sampler)
 state.text_bindings = text_bindings
 state.material_text = textmat.normal {
-	inst_buffer = state.text_inst,
+	inst_stream = text_stream,
 	bindings = state.text_bindings,
 	uniform = state.uniform,
 	sr_buffer = state.srbuffer_mem,
 	font_manager = ctx.font.cobj,
-	tmp_buffer = ctx.tmp_buffer,
+	sr_direct = setting.sr_direct,
 }
 
 local material = {}
 
 function material.reset()
 	text_bindings:base(0)
+	text_stream:reset()
+end
+
+function material.flush()
+	text_stream:flush()
 end
 
 function material.submit(ptr, n)
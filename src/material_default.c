@@ -10,44 +10,86 @@
 #include "spritemgr.h"
 #include "material_util.h"
 #include "render_bindings.h"
-#include "tmpbuffer.h"
 
 struct inst_object {
 	float x, y;
-	float sr_index;
+	union {
+		float index;	// index of sr buffer
+		uint32_t direct;	// draw_primitive.sr, decoded by texquad_direct
+	} sr;
 	uint32_t offset;
 	uint32_t u;
 	uint32_t v;
 };
 
+// 16 bytes instance of texquad_compact, sprite rects are read from a storage buffer
+struct inst_compact {
+	int32_t x, y;	// 24.8 fix number, as draw_primitive
+	uint32_t sr;	// index of sr buffer, or draw_primitive.sr for texquad_compact_direct
+	uint32_t sprite;	// index of sprite rect
+};
+
 struct material_default {
 	sg_pipeline pip;
-	sg_buffer inst;
+	sg_pipeline pip_layer;	// layer textures are premultiplied
+	struct inst_stream *inst;
 	struct render_bindings *bind;
 	vs_params_t *uniform;
 	struct sr_buffer *srbuffer;
 	struct sprite_bank *bank;
-	struct tmp_buffer tmp;
+	int direct;
+	int compact;
+	int premultiplied;
+	size_t inst_size;
+	sg_buffer rect_buffer;
 };
 
+static inline uint32_t
+sr_value(lua_State *L, struct material_default *m, uint32_t sr) {
+	if (m->direct)
+		return sr;
+	// calc scale/rot index
+	int sr_index = srbuffer_add(m->srbuffer, sr);
+	if (sr_index < 0) {
+		// todo: support multiply srbuffer
+		luaL_error(L, "sr buffer is full");
+	}
+	return (uint32_t)sr_index;
+}
+
+static void
+submit_compact(lua_State *L, struct material_default *m, struct draw_primitive *prim, int n) {
+	struct inst_compact *tmp = (struct inst_compact *)util_inst_alloc(L, m->inst, n, sizeof(struct inst_compact));
+	int i;
+	for (i=0;i<n;i++) {
+		struct draw_primitive *p = &prim[i];
+		assert(p->sprite > 0);
+		tmp[i].x = p->x;
+		tmp[i].y = p->y;
+		tmp[i].sr = sr_value(L, m, p->sr);
+		tmp[i].sprite = p->sprite - 1;
+	}
+}
+
 static void
-submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
-	struct material_default *m = (struct material_default *)m_;
+submit(lua_State *L, struct material_default *m, struct draw_primitive *prim, int n) {
+	if (m->compact) {
+		submit_compact(L, m, prim, n);
+		return;
+	}
 	struct sprite_rect *rect = m->bank->rect;
-	struct inst_object *tmp = TMPBUFFER_PTR(struct inst_object, &m->tmp);
+	struct inst_object *tmp = (struct inst_object *)util_inst_alloc(L, m->inst, n, sizeof(struct inst_object));
 	int i;
 	for (i=0;i<n;i++) {
 		struct draw_primitive *p = &prim[i];
 		
-		// calc scale/rot index
-		int sr_index = srbuffer_add(m->srbuffer, p->sr);
-		if (sr_index < 0) {
-			// todo: support multiply srbuffer
-			luaL_error(L, "sr buffer is full");
+		if (m->direct) {
+			tmp[i].sr.direct = p->sr;
+		} else {
+			tmp[i].sr.index = (float)sr_value(L, m, p->sr);
 		}
 		tmp[i].x = (float)p->x / 256.0f;
 		tmp[i].y = (float)p->y / 256.0f;
-		tmp[i].sr_index = (float)sr_index;
 		
 		int index = p->sprite - 1;
 		assert(index >= 0);
@@ -56,14 +98,14 @@ submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
 		tmp[i].u = r->u;
 		tmp[i].v = r->v;
 	}
-	sg_append_buffer(m->inst, &(sg_range) { tmp , n * sizeof(tmp[0]) });
 }
 
 static int
 lmaterial_default_submit(lua_State *L) {
 	struct material_default *m = (struct material_default *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_DEFAULT");
-	int batch_n = TMPBUFFER_SIZE(struct inst_object, &m->tmp);
-	util_submit_material(L, batch_n, m, submit);
+	struct draw_primitive *prim = lua_touserdata(L, 2);
+	int prim_n = luaL_checkinteger(L, 3);
+	submit(L, m, prim, prim_n);
 	return 0;
 }
 
@@ -72,16 +114,16 @@ lmaterial_default_draw_(lua_State *L, int ex) {
 	struct material_default *m = (struct material_default *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_DEFAULT");
 //	struct draw_primitive *prim = lua_touserdata(L, 2);
 	int prim_n = luaL_checkinteger(L, 3);
-//	int tex_id = luaL_checkinteger(L, 4);
+	int tex_id = luaL_checkinteger(L, 4);
 
-	sg_apply_pipeline(m->pip);
+	sg_apply_pipeline(tex_id >= LAYER_TEXTUREID ? m->pip_layer : m->pip);
 	sg_apply_uniforms(UB_vs_params, &(sg_range){ m->uniform, sizeof(vs_params_t) });
 	
 	if (ex) {
 		sg_apply_bindings(&m->bind->bindings);
 		sg_draw_ex(0, 4, prim_n, 0, m->bind->base);
 	} else {
-		size_t base = m->bind->base * sizeof(struct inst_object);
+		size_t base = m->bind->base * m->inst_size;
 		m->bind->bindings.vertex_buffer_offsets[0] += base;
 		sg_apply_bindings(&m->bind->bindings);
 		sg_draw(0, 4, prim_n);
@@ -92,6 +134,16 @@ lmaterial_default_draw_(lua_State *L, int ex) {
 	return 0;
 }
 
+// upload the rects of sprite bank for the compact instances, call it after the bank changes
+static int
+lmaterial_default_update_rects(lua_State *L) {
+	struct material_default *m = (struct material_default *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_DEFAULT");
+	if (m->compact && m->bank->n > 0) {
+		sg_update_buffer(m->rect_buffer, &(sg_range){ m->bank->rect, m->bank->n * sizeof(struct sprite_rect) });
+	}
+	return 0;
+}
+
 static int
 lmaterial_default_draw(lua_State *L) {
 	return lmaterial_default_draw_(L, 0);
@@ -102,8 +154,34 @@ lmaterial_default_draw_ex(lua_State *L) {
 	return lmaterial_default_draw_(L, 1);
 }
 
-static void
-init_pipeline(struct material_default *p) {
+static sg_pipeline
+make_pipeline(struct material_default *p, int blend) {
+	if (p->compact) {
+		sg_pipeline_desc desc = { 0 };
+		if (p->direct) {
+			desc.layout.attrs[ATTR_texquad_compact_direct_position].format = SG_VERTEXFORMAT_INT2;
+			desc.layout.attrs[ATTR_texquad_compact_direct_sr].format = SG_VERTEXFORMAT_UINT;
+			desc.layout.attrs[ATTR_texquad_compact_direct_sprite].format = SG_VERTEXFORMAT_UINT;
+			return util_make_pipeline(&desc, texquad_compact_direct_shader_desc, "default-compact-direct-pipeline", blend);
+		} else {
+			desc.layout.attrs[ATTR_texquad_compact_position].format = SG_VERTEXFORMAT_INT2;
+			desc.layout.attrs[ATTR_texquad_compact_sr_index].format = SG_VERTEXFORMAT_UINT;
+			desc.layout.attrs[ATTR_texquad_compact_sprite].format = SG_VERTEXFORMAT_UINT;
+			return util_make_pipeline(&desc, texquad_compact_shader_desc, "default-compact-pipeline", blend);
+		}
+	}
+	if (p->direct) {
+		sg_pipeline_desc desc = {
+			.layout.attrs = {
+				[ATTR_texquad_direct_position].format = SG_VERTEXFORMAT_FLOAT2,
+				[ATTR_texquad_direct_sr].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_offset].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_u].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_v].format = SG_VERTEXFORMAT_UINT,
+			},
+		};
+		return util_make_pipeline(&desc, texquad_direct_shader_desc, "default-direct-pipeline", blend);
+	}
 	sg_pipeline_desc desc = {
 		.layout.attrs = {
 			[ATTR_texquad_position].format = SG_VERTEXFORMAT_FLOAT3,
@@ -112,19 +190,46 @@ init_pipeline(struct material_default *p) {
 			[ATTR_texquad_v].format = SG_VERTEXFORMAT_UINT,
         },
 	};
-	p->pip = util_make_pipeline(&desc, texquad_shader_desc, "default-pipeline", 1);
+	return util_make_pipeline(&desc, texquad_shader_desc, "default-pipeline", blend);
+}
+
+static void
+init_pipeline(struct material_default *p) {
+	// atlas textures are premultiplied, see setting atlas_premultiply
+	if (p->premultiplied) {
+		p->pip = make_pipeline(p, UTIL_BLEND_PREMULTIPLIED);
+		p->pip_layer = p->pip;
+	} else {
+		p->pip = make_pipeline(p, 1);
+		p->pip_layer = make_pipeline(p, UTIL_BLEND_PREMULTIPLIED);
+	}
 }
 
 static int
 lnew_material_default(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
 	struct material_default *m = (struct material_default *)lua_newuserdatauv(L, sizeof(*m), 5);
+	lua_getfield(L, 1, "sr_direct");
+	m->direct = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "premultiplied");
+	m->premultiplied = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+	if (lua_getfield(L, 1, "rect_buffer") != LUA_TNIL) {
+		lua_pop(L, 1);
+		m->compact = 1;
+		m->inst_size = sizeof(struct inst_compact);
+		util_ref_object(L, &m->rect_buffer, 5, "rect_buffer", "SOKOL_BUFFER", 0);
+	} else {
+		lua_pop(L, 1);
+		m->compact = 0;
+		m->inst_size = sizeof(struct inst_object);
+	}
 	init_pipeline(m);
-	util_ref_object(L, &m->inst, 1, "inst_buffer", "SOKOL_BUFFER", 0);
+	util_ref_object(L, &m->inst, 1, "inst_stream", "SOLUNA_INSTSTREAM", 1);
 	util_ref_object(L, &m->bind, 2, "bindings", "SOKOL_BINDINGS", 1);
 	util_ref_object(L, &m->uniform, 3, "uniform", "SOKOL_UNIFORM", 1);
 	util_ref_object(L, &m->srbuffer, 4, "sr_buffer", "SOLUNA_SRBUFFER", 1);
-	tmp_buffer_init(L, &m->tmp, 5, "tmp_buffer");
 	if (lua_getfield(L, 1, "sprite_bank") != LUA_TLIGHTUSERDATA) {
 		return luaL_error(L, "Missing .sprite_bank");
 	}
@@ -136,6 +241,7 @@ lnew_material_default(lua_State *L) {
 			{ "__index", NULL },
 			{ "submit", lmaterial_default_submit },
 			{ "draw", DRAWFUNC(lmaterial_default_draw) },
+			{ "update_rects", lmaterial_default_update_rects },
 			{ NULL, NULL },
 		};
 		luaL_setfuncs(L, l, 0);
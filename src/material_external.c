@@ -14,12 +14,19 @@
 
 #define STREAM_FIX_INV_SCALE (1.0f / 256.0f)
 
+// uniform block of item_uniform_slot when items are in a storage buffer : the index of first instance
+struct item_base {
+	int base;
+	int padding[3];
+};
+
 union material_func {
 	void *ptr;
 	material_shader_desc_func shader_desc;
 	material_pipeline_desc_func pipeline_desc;
 	material_submit_one_func submit_one;
 	material_uniform_one_func uniform_one;
+	material_submit_many_func submit_many;
 };
 
 struct material_external {
@@ -38,10 +45,19 @@ struct material_external {
 	size_t uniform_size;
 	void *item_uniform;
 	size_t item_uniform_size;
+	// per item uniforms in a storage buffer, indexed by instance
+	sg_buffer item_buffer;
+	char *items;
+	int item_n;
+	int item_cap;
 	struct sr_buffer *srbuffer;
 	struct sprite_bank *bank;
 	material_submit_one_func submit_one;
 	material_uniform_one_func uniform_one;
+	material_submit_many_func submit_many;
+	// reused by submit : decoded items[scratch_cap], then instances
+	struct material_item *scratch;
+	int scratch_cap;
 };
 
 static void
@@ -63,7 +79,6 @@ decode_item(lua_State *L, struct material_external *m, struct draw_primitive *pr
 	if (pos->sprite != -m->material_id) {
 		luaL_error(L, "Invalid material marker");
 	}
-	memset(item, 0, sizeof(*item));
 	item->x = (float)pos->x * STREAM_FIX_INV_SCALE;
 	item->y = (float)pos->y * STREAM_FIX_INV_SCALE;
 	item->transform_index = -1;
@@ -82,6 +97,8 @@ decode_item(lua_State *L, struct material_external *m, struct draw_primitive *pr
 		}
 		read_sprite_rect(&m->bank->rect[item->sprite], &item->rect);
 		item->texture = item->rect.texture;
+	} else {
+		memset(&item->rect, 0, sizeof(item->rect));
 	}
 }
 
@@ -103,9 +120,27 @@ static int
 lmaterial_external_reset(lua_State *L) {
 	struct material_external *m = (struct material_external *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_EXTERNAL");
 	m->bind->base = 0;
+	m->item_n = 0;
 	return 0;
 }
 
+static struct material_item *
+submit_scratch(lua_State *L, struct material_external *m, int n) {
+	if (n > m->scratch_cap) {
+		int cap = m->scratch_cap > 0 ? m->scratch_cap : 256;
+		while (cap < n)
+			cap *= 2;
+		size_t size = sizeof(struct material_item) + (size_t)m->instance_size;
+		if ((size_t)cap > ~(size_t)0 / size) {
+			luaL_error(L, "External material instance buffer is too large");
+		}
+		m->scratch = (struct material_item *)lua_newuserdatauv(L, (size_t)cap * size, 0);
+		lua_setiuservalue(L, 1, 9);
+		m->scratch_cap = cap;
+	}
+	return m->scratch;
+}
+
 static int
 lmaterial_external_submit(lua_State *L) {
 	struct material_external *m = (struct material_external *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_EXTERNAL");
@@ -114,40 +149,62 @@ lmaterial_external_submit(lua_State *L) {
 	if (prim == NULL || prim_n <= 0) {
 		return 0;
 	}
-	if ((size_t)prim_n > ~(size_t)0 / (size_t)m->instance_size) {
-		return luaL_error(L, "External material instance buffer is too large");
+	if (m->items != NULL && m->item_n + prim_n > m->item_cap) {
+		return luaL_error(L, "Too many external material items (%d)", m->item_n + prim_n);
 	}
+	struct material_item *items = submit_scratch(L, m, prim_n);
+	char *buffer = (char *)(items + m->scratch_cap);
 	size_t buffer_size = (size_t)prim_n * (size_t)m->instance_size;
-	char *buffer = (char *)lua_newuserdatauv(L, buffer_size, 0);
+	memset(buffer, 0, buffer_size);
+	material_error err = NULL;
 	int i;
 	for (i = 0; i < prim_n; i++) {
-		void *instance = buffer + (size_t)i * (size_t)m->instance_size;
-		struct material_item item;
-		decode_item(L, m, prim, i, 1, &item);
-		memset(instance, 0, (size_t)m->instance_size);
-		material_error err = m->submit_one(&item, instance);
-		if (err != NULL) {
-			return luaL_error(L, "%s", err);
+		decode_item(L, m, prim, i, 1, &items[i]);
+	}
+	if (m->submit_many != NULL) {
+		err = m->submit_many(items, prim_n, buffer);
+	} else {
+		for (i = 0; i < prim_n && err == NULL; i++) {
+			err = m->submit_one(&items[i], buffer + (size_t)i * (size_t)m->instance_size);
+		}
+	}
+	if (m->items != NULL) {
+		for (i = 0; i < prim_n && err == NULL; i++) {
+			void *uniform = m->items + (size_t)(m->item_n + i) * m->item_uniform_size;
+			memset(uniform, 0, m->item_uniform_size);
+			err = m->uniform_one(&items[i], uniform);
 		}
+		m->item_n += prim_n;
+	}
+	if (err != NULL) {
+		return luaL_error(L, "%s", err);
 	}
 	sg_append_buffer(m->inst, &(sg_range){ buffer, buffer_size });
-	lua_pop(L, 1);
+	return 0;
+}
+
+static int
+lmaterial_external_flush(lua_State *L) {
+	struct material_external *m = (struct material_external *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_EXTERNAL");
+	if (m->item_n > 0) {
+		sg_update_buffer(m->item_buffer, &(sg_range){ m->items, (size_t)m->item_n * m->item_uniform_size });
+	}
 	return 0;
 }
 
 static void
-draw_one(struct material_external *m, int ex) {
+draw_n(struct material_external *m, int n, int ex) {
 	if (ex) {
 		sg_apply_bindings(&m->bind->bindings);
-		sg_draw_ex(m->base_element, m->vertex_count, 1, 0, m->bind->base);
+		sg_draw_ex(m->base_element, m->vertex_count, n, 0, m->bind->base);
 	} else {
 		size_t offset = (size_t)m->bind->base * (size_t)m->instance_size;
 		m->bind->bindings.vertex_buffer_offsets[0] += offset;
 		sg_apply_bindings(&m->bind->bindings);
-		sg_draw(m->base_element, m->vertex_count, 1);
+		sg_draw(m->base_element, m->vertex_count, n);
 		m->bind->bindings.vertex_buffer_offsets[0] -= offset;
 	}
-	m->bind->base++;
+	m->bind->base += n;
 }
 
 static int
@@ -164,19 +221,29 @@ lmaterial_external_draw_(lua_State *L, int ex) {
 	if (m->uniform != NULL) {
 		sg_apply_uniforms(m->uniform_slot, &(sg_range){ m->uniform, m->uniform_size });
 	}
+	if (m->uniform_one == NULL) {
+		draw_n(m, prim_n, ex);
+		return 0;
+	}
+	if (m->items != NULL) {
+		// The shader reads items[base + instance index], instance index starts from 0 on every backend
+		// only when the base instance is not used, so always offset the vertex buffer here.
+		struct item_base base = { m->bind->base };
+		sg_apply_uniforms(m->item_uniform_slot, &(sg_range){ &base, sizeof(base) });
+		draw_n(m, prim_n, 0);
+		return 0;
+	}
 	int i;
 	for (i = 0; i < prim_n; i++) {
-		if (m->uniform_one != NULL) {
-			struct material_item item;
-			decode_item(L, m, prim, i, 0, &item);
-			memset(m->item_uniform, 0, m->item_uniform_size);
-			material_error err = m->uniform_one(&item, m->item_uniform);
-			if (err != NULL) {
-				return luaL_error(L, "%s", err);
-			}
-			sg_apply_uniforms(m->item_uniform_slot, &(sg_range){ m->item_uniform, m->item_uniform_size });
+		struct material_item item;
+		decode_item(L, m, prim, i, 0, &item);
+		memset(m->item_uniform, 0, m->item_uniform_size);
+		material_error err = m->uniform_one(&item, m->item_uniform);
+		if (err != NULL) {
+			return luaL_error(L, "%s", err);
 		}
-		draw_one(m, ex);
+		sg_apply_uniforms(m->item_uniform_slot, &(sg_range){ m->item_uniform, m->item_uniform_size });
+		draw_n(m, 1, ex);
 	}
 	return 0;
 }
@@ -205,6 +272,13 @@ lmaterial_external_submit_closure(lua_State *L) {
 	return lmaterial_external_submit(L);
 }
 
+static int
+lmaterial_external_flush_closure(lua_State *L) {
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	return lmaterial_external_flush(L);
+}
+
 static int
 lmaterial_external_draw_closure(lua_State *L) {
 	lua_pushvalue(L, lua_upvalueindex(1));
@@ -326,7 +400,7 @@ ref_uniform(lua_State *L, int material_index, int uv_index, const char *key, voi
 static int
 lnew_material_external(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
-	struct material_external *m = (struct material_external *)lua_newuserdatauv(L, sizeof(*m), 7);
+	struct material_external *m = (struct material_external *)lua_newuserdatauv(L, sizeof(*m), 9);
 	memset(m, 0, sizeof(*m));
 	int material_index = lua_gettop(L);
 	m->material_id = checkinteger_field(L, 1, "id");
@@ -343,10 +417,16 @@ lnew_material_external(lua_State *L) {
 	m->item_uniform_slot = optinteger_field(L, 1, "item_uniform_slot", 1);
 	m->texture_view_slot = optinteger_field(L, 1, "texture_view_slot", -1);
 	int hooks_index = checktable_field(L, 1, "hooks");
-	union material_func submit = {
-		.ptr = check_lightuserdata_field(L, hooks_index, "submit"),
+	union material_func submit_many = {
+		.ptr = optional_lightuserdata_field(L, hooks_index, "submit_many"),
 	};
-	m->submit_one = submit.submit_one;
+	m->submit_many = submit_many.submit_many;
+	if (m->submit_many == NULL) {
+		union material_func submit = {
+			.ptr = check_lightuserdata_field(L, hooks_index, "submit"),
+		};
+		m->submit_one = submit.submit_one;
+	}
 	union material_func uniform = {
 		.ptr = optional_lightuserdata_field(L, hooks_index, "uniform"),
 	};
@@ -361,6 +441,18 @@ lnew_material_external(lua_State *L) {
 	if (m->uniform_one != NULL && m->item_uniform == NULL) {
 		return luaL_error(L, "Missing .item_uniform");
 	}
+	if (m->uniform_one != NULL && lua_getfield(L, 1, "item_buffer") != LUA_TNIL) {
+		lua_pop(L, 1);
+		util_ref_object(L, &m->item_buffer, 7, "item_buffer", "SOKOL_BUFFER", 0);
+		m->item_cap = checkinteger_field(L, 1, "item_count");
+		if (m->item_cap <= 0) {
+			return luaL_error(L, "Invalid item count %d", m->item_cap);
+		}
+		m->items = (char *)lua_newuserdatauv(L, (size_t)m->item_cap * m->item_uniform_size, 0);
+		lua_setiuservalue(L, material_index, 8);
+	} else {
+		lua_pop(L, 1);
+	}
 	if (lua_getfield(L, 1, "sprite_bank") == LUA_TLIGHTUSERDATA) {
 		m->bank = (struct sprite_bank *)lua_touserdata(L, -1);
 	}
@@ -381,6 +473,11 @@ lnew_material_external(lua_State *L) {
 	lua_pushvalue(L, material_index);
 	lua_pushcclosure(L, lmaterial_external_submit_closure, 1);
 	lua_setfield(L, result_index, "submit");
+	if (m->items != NULL) {
+		lua_pushvalue(L, material_index);
+		lua_pushcclosure(L, lmaterial_external_flush_closure, 1);
+		lua_setfield(L, result_index, "flush");
+	}
 	lua_pushvalue(L, material_index);
 	lua_pushcclosure(L, DRAWFUNC(lmaterial_external_draw_closure), 1);
 	lua_setfield(L, result_index, "draw");
@@ -10,7 +10,6 @@
 #include "spritemgr.h"
 #include "material_util.h"
 #include "render_bindings.h"
-#include "tmpbuffer.h"
 
 struct color {
 	unsigned char channel[4];
@@ -32,21 +31,19 @@ struct mask {
 
 struct material_mask {
 	sg_pipeline pip;
-	sg_buffer inst;
+	struct inst_stream *inst;
 	struct render_bindings *bind;
 	vs_params_t *uniform;
 	struct sr_buffer *srbuffer;
 	struct sprite_bank *bank;
-	struct tmp_buffer tmp;
 };
 
 static int material_id = 0;
 
 static void
-submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
-	struct material_mask *m =(struct material_mask *)m_;
+submit(lua_State *L, struct material_mask *m, struct draw_primitive *prim, int n) {
 	struct sprite_rect *rect = m->bank->rect;
-	struct inst_object *tmp = TMPBUFFER_PTR(struct inst_object, &m->tmp);
+	struct inst_object *tmp = (struct inst_object *)util_inst_alloc(L, m->inst, n, sizeof(struct inst_object));
 	int i;
 	for (i=0;i<n;i++) {
 		struct draw_primitive *p = &prim[i*2];
@@ -72,14 +69,14 @@ submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
 		tmp[i].u = r->u;
 		tmp[i].v = r->v;
 	}
-	sg_append_buffer(m->inst, &(sg_range) { tmp , n * sizeof(tmp[0]) });
 }
 
 static int
 lmaterial_mask_submit(lua_State *L) {
 	struct material_mask *m = (struct material_mask *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_MASK");
-	int batch_n = TMPBUFFER_SIZE(struct inst_object, &m->tmp);
-	util_submit_material(L, batch_n, m, submit);
+	struct draw_primitive *prim = lua_touserdata(L, 2);
+	int prim_n = luaL_checkinteger(L, 3);
+	submit(L, m, prim, prim_n);
 	return 0;
 }
 
@@ -146,13 +143,12 @@ init_pipeline(struct material_mask *p) {
 static int
 lnew_material_mask(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
-	struct material_mask *m = (struct material_mask *)lua_newuserdatauv(L, sizeof(*m), 5);
+	struct material_mask *m = (struct material_mask *)lua_newuserdatauv(L, sizeof(*m), 4);
 	init_pipeline(m);
-	util_ref_object(L, &m->inst, 1, "inst_buffer", "SOKOL_BUFFER", 0);
+	util_ref_object(L, &m->inst, 1, "inst_stream", "SOLUNA_INSTSTREAM", 1);
 	util_ref_object(L, &m->bind, 2, "bindings", "SOKOL_BINDINGS", 1);
 	util_ref_object(L, &m->uniform, 3, "uniform", "SOKOL_UNIFORM", 1);
 	util_ref_object(L, &m->srbuffer, 4, "sr_buffer", "SOLUNA_SRBUFFER", 1);
-	tmp_buffer_init(L, &m->tmp, 5, "tmp_buffer");
 	if (lua_getfield(L, 1, "sprite_bank") != LUA_TLIGHTUSERDATA) {
 		return luaL_error(L, "Missing .sprite_bank");
 	}
@@ -10,7 +10,6 @@
 #include "spritemgr.h"
 #include "material_util.h"
 #include "render_bindings.h"
-#include "tmpbuffer.h"
 
 struct color {
 	unsigned char channel[4];
@@ -26,25 +25,24 @@ struct quad {
 struct inst_object {
 	float x, y;
 	float w, h;
-	int sr_index;
+	uint32_t sr;	// index of sr buffer, or draw_primitive.sr for colorquad_direct
 	struct color c;
 };
 
 struct material_quad {
 	sg_pipeline pip;
-	sg_buffer inst;
+	struct inst_stream *inst;
 	struct render_bindings *bind;
 	vs_params_t *uniform;
 	struct sr_buffer *srbuffer;
-	struct tmp_buffer tmp;
+	int direct;
 };
 
 static int material_id = 0;
 
 static void
-submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
-	struct material_quad *m = (struct material_quad *)m_;
-	struct inst_object *tmp = TMPBUFFER_PTR(struct inst_object, &m->tmp);
+submit(lua_State *L, struct material_quad *m, struct draw_primitive *prim, int n) {
+	struct inst_object *tmp = (struct inst_object *)util_inst_alloc(L, m->inst, n, sizeof(struct inst_object));
 	int i;
 	for (i=0;i<n;i++) {
 		struct draw_primitive *p = &prim[i*2];
@@ -52,28 +50,32 @@ submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
 		
 		struct quad * q = (struct quad *)&prim[i*2+1];
 		
-		// calc scale/rot index
-		int sr_index = srbuffer_add(m->srbuffer, p->sr);
-		if (sr_index < 0) {
-			// todo: support multiply srbuffer
-			luaL_error(L, "sr buffer is full");
-		}
 		struct inst_object *inst = &tmp[i];
+		if (m->direct) {
+			inst->sr = p->sr;
+		} else {
+			// calc scale/rot index
+			int sr_index = srbuffer_add(m->srbuffer, p->sr);
+			if (sr_index < 0) {
+				// todo: support multiply srbuffer
+				luaL_error(L, "sr buffer is full");
+			}
+			inst->sr = sr_index;
+		}
 		inst->x = (float)p->x / 256.0f;
 		inst->y = (float)p->y / 256.0f;
 		inst->w = q->w;
 		inst->h = q->h;
-		inst->sr_index = sr_index;
 		inst->c = q->c;
 	}
-	sg_append_buffer(m->inst, &(sg_range) { tmp , n * sizeof(tmp[0]) });
 }
 
 static int
 lmateraial_quad_submit(lua_State *L) {
 	struct material_quad *m = (struct material_quad *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_QUAD");
-	int batch_n = TMPBUFFER_SIZE(struct inst_object, &m->tmp);
-	util_submit_material(L, batch_n, m, submit);
+	struct draw_primitive *prim = lua_touserdata(L, 2);
+	int prim_n = luaL_checkinteger(L, 3);
+	submit(L, m, prim, prim_n);
 	return 0;
 }
 
@@ -125,6 +127,17 @@ lset_material_id(lua_State *L) {
 
 static void
 init_pipeline(struct material_quad *p) {
+	if (p->direct) {
+		sg_pipeline_desc desc = {
+			.layout.attrs = {
+				[ATTR_colorquad_direct_position].format = SG_VERTEXFORMAT_FLOAT4,
+				[ATTR_colorquad_direct_sr].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_colorquad_direct_c].format = SG_VERTEXFORMAT_UBYTE4N,
+			},
+		};
+		p->pip = util_make_pipeline(&desc, colorquad_direct_shader_desc, "colorquad-direct-pipeline", 1);
+		return;
+	}
 	sg_pipeline_desc desc = {
 		.layout.attrs = {
 			[ATTR_colorquad_position].format = SG_VERTEXFORMAT_FLOAT4,
@@ -138,12 +151,14 @@ init_pipeline(struct material_quad *p) {
 static int
 lnew_material_quad(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
-	struct material_quad *m = (struct material_quad *)lua_newuserdatauv(L, sizeof(*m), 5);
-	util_ref_object(L, &m->inst, 1, "inst_buffer", "SOKOL_BUFFER", 0);
+	struct material_quad *m = (struct material_quad *)lua_newuserdatauv(L, sizeof(*m), 4);
+	util_ref_object(L, &m->inst, 1, "inst_stream", "SOLUNA_INSTSTREAM", 1);
 	util_ref_object(L, &m->bind, 2, "bindings", "SOKOL_BINDINGS", 1);
 	util_ref_object(L, &m->uniform, 3, "uniform", "SOKOL_UNIFORM", 1);
 	util_ref_object(L, &m->srbuffer, 4, "sr_buffer", "SOLUNA_SRBUFFER", 1);
-	tmp_buffer_init(L, &m->tmp, 5, "tmp_buffer");
+	lua_getfield(L, 1, "sr_direct");
+	m->direct = lua_toboolean(L, -1);
+	lua_pop(L, 1);
 	init_pipeline(m);
 
 	if (luaL_newmetatable(L, "SOLUNA_MATERIAL_QUAD")) {
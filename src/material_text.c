@@ -15,7 +15,7 @@
 #include "sprite_submit.h"
 #include "material_util.h"
 #include "render_bindings.h"
-#include "tmpbuffer.h"
+#include "arena.h"
 
 #define PIXEL_SCALE 256
 
@@ -29,29 +29,71 @@ struct text {
 
 struct inst_object {
 	float x, y;
-	float sr_index;
+	union {
+		float index;	// index of sr buffer
+		uint32_t direct;	// draw_primitive.sr, decoded by texquad_direct
+	} sr;
     uint32_t offset;
     uint32_t u;
     uint32_t v;
+    uint32_t color;
+};
+
+// Per frame glyph memo : (font, size, codepoint) -> instance fields.
+// Entries are valid only in the font manager version (frame) they are filled,
+// the first lookup in a frame touches the glyph in font manager, so it can't be evicted in this frame.
+#define GLYPH_MEMO_SIZE 4096
+
+struct glyph_memo {
+	int version;
+	int codepoint;
+	uint16_t font;
+	uint16_t size;
+	uint32_t offset;
+	uint32_t u;
+	uint32_t v;
+	uint32_t scale_fix;
 };
 
 struct material_text {
 	sg_pipeline pip;
-	sg_buffer inst;
+	struct inst_stream *inst;
 	struct render_bindings *bind;
 	vs_params_t *uniform;
 	struct sr_buffer *srbuffer;
 	struct font_manager *font;
 	fs_params_t fs_uniform;
-	struct tmp_buffer tmp;
+	int direct;
+	struct glyph_memo memo[GLYPH_MEMO_SIZE];
 };
 
 static int material_id = 0;
 
+static inline struct glyph_memo *
+glyph_lookup(struct material_text *m, int version, struct text *t) {
+	uint32_t h = (uint32_t)t->codepoint * 2654435761u ^ (uint32_t)t->font * 0x9e37u ^ (uint32_t)t->size * 0x85ebu;
+	struct glyph_memo *e = &m->memo[h % GLYPH_MEMO_SIZE];
+	if (e->version == version && e->codepoint == t->codepoint && e->font == t->font && e->size == t->size)
+		return e;
+	struct font_glyph g, og;
+	const char* err = font_manager_glyph(m->font, t->font, t->codepoint, t->size, &g, &og);
+	if (err != NULL)
+		return NULL;
+	e->version = version;
+	e->codepoint = t->codepoint;
+	e->font = t->font;
+	e->size = t->size;
+	e->offset = (-og.offset_x + 0x8000) << 16 | (-og.offset_y + 0x8000);
+	e->u = og.u << 16 | FONT_MANAGER_GLYPHSIZE;
+	e->v = og.v << 16 | FONT_MANAGER_GLYPHSIZE;
+	e->scale_fix = og.w == 0 ? 0 : (g.w << 12) / og.w;
+	return e;
+}
+
 static void
-submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
-	struct material_text *m = (struct material_text *)m_;
-	struct inst_object *tmp = TMPBUFFER_PTR(struct inst_object, &m->tmp);
+submit(lua_State *L, struct material_text *m, struct draw_primitive *prim, int n) {
+	struct inst_object *tmp = (struct inst_object *)util_inst_alloc(L, m->inst, n, sizeof(struct inst_object));
+	int version = font_manager_version(m->font);
 	int i;
 	int count = 0;
 	for (i=0;i<n;i++) {
@@ -59,59 +101,45 @@ submit(lua_State *L, void *m_, struct draw_primitive *prim, int n) {
 		assert(p->sprite == -material_id);
 		
 		struct text * t = (struct text *)&prim[i*2+1];
-		struct font_glyph g, og;
-		const char* err = font_manager_glyph(m->font, t->font, t->codepoint, t->size, &g, &og);
-		if (err == NULL) {
-			tmp[count].offset = (-og.offset_x + 0x8000) << 16 | (-og.offset_y + 0x8000);
-			tmp[count].u = og.u << 16 | FONT_MANAGER_GLYPHSIZE;
-			tmp[count].v = og.v << 16 | FONT_MANAGER_GLYPHSIZE;
+		struct glyph_memo *g = glyph_lookup(m, version, t);
+		if (g) {
+			tmp[count].offset = g->offset;
+			tmp[count].u = g->u;
+			tmp[count].v = g->v;
 			
-			uint32_t scale_fix = og.w == 0 ? 0 : (g.w << 12) / og.w;
-			sprite_apply_scale(p, scale_fix);
-			// calc scale/rot index
-			int sr_index = srbuffer_add(m->srbuffer, p->sr);
-			if (sr_index < 0) {
-				// todo: support multiply srbuffer
-				luaL_error(L, "sr buffer is full");
+			sprite_apply_scale(p, g->scale_fix);
+			if (m->direct) {
+				tmp[count].sr.direct = p->sr;
+			} else {
+				// calc scale/rot index
+				int sr_index = srbuffer_add(m->srbuffer, p->sr);
+				if (sr_index < 0) {
+					// todo: support multiply srbuffer
+					luaL_error(L, "sr buffer is full");
+				}
+				tmp[count].sr.index = (float)sr_index;
 			}
 			tmp[count].x = (float)p->x / PIXEL_SCALE;
 			tmp[count].y = (float)p->y / PIXEL_SCALE;
-			tmp[count].sr_index = (float)sr_index;
+			tmp[count].color = t->color;
 			++count;
 		} else {
 			t->codepoint = -1;
 		}
 	}
-	sg_append_buffer(m->inst, &(sg_range) { tmp , count * sizeof(tmp[0]) });
+	// missing glyphs
+	inst_stream_shrink(m->inst, (n - count) * sizeof(tmp[0]));
 }
 
 static int
 lmateraial_text_submit(lua_State *L) {
 	struct material_text *m = (struct material_text *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_TEXT");
-	int batch_n = TMPBUFFER_SIZE(struct inst_object, &m->tmp);
-	util_submit_material(L, batch_n, m, submit);
+	struct draw_primitive *prim = lua_touserdata(L, 2);
+	int prim_n = luaL_checkinteger(L, 3);
+	submit(L, m, prim, prim_n);
 	return 0;
 }
 
-static inline void
-draw_text(struct material_text *m, uint32_t color, int count, int ex) {
-	m->fs_uniform.color = color;
-	sg_apply_uniforms(UB_vs_params, &(sg_range){ m->uniform, sizeof(vs_params_t) });
-	sg_apply_uniforms(UB_fs_params, &(sg_range){ &m->fs_uniform, sizeof(fs_params_t) });
-	if (ex) {
-		sg_apply_bindings(&m->bind->bindings);
-		sg_draw_ex(0, 4, count, 0, m->bind->base);
-	} else {
-		size_t base = m->bind->base * sizeof(struct inst_object);
-		m->bind->bindings.vertex_buffer_offsets[0] += base;
-		sg_apply_bindings(&m->bind->bindings);
-		sg_draw(0, 4, count);
-		m->bind->bindings.vertex_buffer_offsets[0] -= base;
-	}
-
-	m->bind->base += count;
-}
-
 static inline int
 lmateraial_text_draw_(lua_State *L, int ex) {
 	struct material_text *m = (struct material_text *)luaL_checkudata(L, 1, "SOLUNA_MATERIAL_TEXT");
@@ -120,30 +148,33 @@ lmateraial_text_draw_(lua_State *L, int ex) {
 	if (prim_n <= 0)
 		return 0;
 	
+	// glyphs missing at submit are not in instance buffer
 	int i;
-	float texsize = m->uniform->texsize;
-	m->uniform->texsize = 1.0f / FONT_MANAGER_TEXSIZE;
-	sg_apply_pipeline(m->pip);
-	
-	int count = -1;
-	uint32_t color = 0;
+	int count = 0;
 	for (i=0;i<prim_n;i++) {
 		struct text * t = (struct text *)&prim[i*2+1];
-		if (t->codepoint >= 0) {
-			if (count < 0) {
-				color = t->color;
-				count = 1;
-			} else if (t->color != color) {
-				draw_text(m, color, count, ex);
-				color = t->color;
-				count = 1;
-			} else {
-				++count;
-			}
-		}
+		if (t->codepoint >= 0)
+			++count;
 	}
-	draw_text(m, color, count, ex);
+	if (count == 0)
+		return 0;
 
+	float texsize = m->uniform->texsize;
+	m->uniform->texsize = 1.0f / FONT_MANAGER_TEXSIZE;
+	sg_apply_pipeline(m->pip);
+	sg_apply_uniforms(UB_vs_params, &(sg_range){ m->uniform, sizeof(vs_params_t) });
+	sg_apply_uniforms(UB_fs_params, &(sg_range){ &m->fs_uniform, sizeof(fs_params_t) });
+	if (ex) {
+		sg_apply_bindings(&m->bind->bindings);
+		sg_draw_ex(0, 4, count, 0, m->bind->base);
+	} else {
+		size_t base = m->bind->base * sizeof(struct inst_object);
+		m->bind->bindings.vertex_buffer_offsets[0] += base;
+		sg_apply_bindings(&m->bind->bindings);
+		sg_draw(0, 4, count);
+		m->bind->bindings.vertex_buffer_offsets[0] -= base;
+	}
+	m->bind->base += count;
 	m->uniform->texsize = texsize;
 
 	return 0;
@@ -161,12 +192,27 @@ lmateraial_text_draw_ex(lua_State *L) {
 
 static void
 init_pipeline(struct material_text *p) {
+	if (p->direct) {
+		sg_pipeline_desc desc = {
+			.layout.attrs = {
+				[ATTR_texquad_direct_position].format = SG_VERTEXFORMAT_FLOAT2,
+				[ATTR_texquad_direct_sr].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_offset].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_u].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_v].format = SG_VERTEXFORMAT_UINT,
+				[ATTR_texquad_direct_color].format = SG_VERTEXFORMAT_UINT,
+			},
+		};
+		p->pip = util_make_pipeline(&desc, texquad_direct_shader_desc, "text-direct-pipeline", 1);
+		return;
+	}
 	sg_pipeline_desc desc = {
 		.layout.attrs = {
 			[ATTR_texquad_position].format = SG_VERTEXFORMAT_FLOAT3,
 			[ATTR_texquad_offset].format = SG_VERTEXFORMAT_UINT,
 			[ATTR_texquad_u].format = SG_VERTEXFORMAT_UINT,
 			[ATTR_texquad_v].format = SG_VERTEXFORMAT_UINT,
+			[ATTR_texquad_color].format = SG_VERTEXFORMAT_UINT,
         },
     };
 	p->pip = util_make_pipeline(&desc, texquad_shader_desc, "text-pipeline", 1);
@@ -175,13 +221,16 @@ init_pipeline(struct material_text *p) {
 static int
 lnew_material_text_normal(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
-	struct material_text *m = (struct material_text *)lua_newuserdatauv(L, sizeof(*m), 5);
-	util_ref_object(L, &m->inst, 1, "inst_buffer", "SOKOL_BUFFER", 0);
+	struct material_text *m = (struct material_text *)lua_newuserdatauv(L, sizeof(*m), 4);
+	util_ref_object(L, &m->inst, 1, "inst_stream", "SOLUNA_INSTSTREAM", 1);
 	util_ref_object(L, &m->bind, 2, "bindings", "SOKOL_BINDINGS", 1);
 	util_ref_object(L, &m->uniform, 3, "uniform", "SOKOL_UNIFORM", 1);
 	util_ref_object(L, &m->srbuffer, 4, "sr_buffer", "SOLUNA_SRBUFFER", 1);
-	tmp_buffer_init(L, &m->tmp, 5, "tmp_buffer");
+	lua_getfield(L, 1, "sr_direct");
+	m->direct = lua_toboolean(L, -1);
+	lua_pop(L, 1);
 	init_pipeline(m);
+	memset(m->memo, 0, sizeof(m->memo));
 
 	if (lua_getfield(L, 1, "font_manager") != LUA_TLIGHTUSERDATA) {
 		return luaL_error(L, "Missing .font_manager");
@@ -192,7 +241,6 @@ lnew_material_text_normal(lua_State *L) {
   fs_params_t temp = {
       .edge_mask = font_manager_sdf_mask(m->font),
       .dist_multiplier = 1.0f,
-      .color = 0xff000000,
   };
   memcpy(&m->fs_uniform, &temp, sizeof(fs_params_t));
 
@@ -512,6 +560,12 @@ ltext_(lua_State *L, int gen_layout) {
 		pos->line_gap = gap;
 		pos->ascent = ctx.ascent;
 		pos->decent = ctx.decent;
+	} else if (lua_toboolean(L, 4)) {
+		// transient block : valid until the end of next frame
+		buffer = (char *)frame_arena_alloc(count * sizeof(struct text_primitive)+1);
+		if (buffer == NULL)
+			return luaL_error(L, "Frame arena : Out of memory");
+		prim = (struct text_primitive *)buffer;
 	} else {
 		buffer = (char *)malloc(count * sizeof(struct text_primitive)+1);
 		prim = (struct text_primitive *)buffer;
@@ -635,7 +689,12 @@ ltext_(lua_State *L, int gen_layout) {
 				prim[i].pos.y += offy;
 			}
 		}
-		lua_pushexternalstring(L, buffer, n * sizeof(struct text_primitive), free_primitive, NULL);
+		size_t sz = n * sizeof(struct text_primitive);
+		buffer[sz] = 0;
+		if (lua_toboolean(L, 4))
+			frame_arena_pushstring(L, buffer, sz);
+		else
+			lua_pushexternalstring(L, buffer, sz, free_primitive, NULL);
 		lua_pushinteger(L, height);
 		return 2;
 	} else {
@@ -21,23 +21,12 @@ util_ref_object(lua_State *L, void *ptr, int uv_index, const char *key, const ch
 	}
 }
 
-void
-util_submit_material(lua_State *L, int batch_n, void *mat, util_submit_func submit) {
-	struct draw_primitive *prim = lua_touserdata(L, 2);
-	int prim_n = luaL_checkinteger(L, 3);
-	int i = 0;
-	for (;;) {
-		int n = prim_n - i;
-		if (n > batch_n) {
-			submit(L, mat, prim, batch_n);
-			i += batch_n;
-			prim += batch_n;
-		} else {
-			submit(L, mat, prim, n);
-			i += batch_n;
-			break;
-		}
-	}
+void *
+util_inst_alloc(lua_State *L, struct inst_stream *s, int n, size_t size) {
+	void *ptr = inst_stream_alloc(s, (size_t)n * size);
+	if (ptr == NULL)
+		luaL_error(L, "Too many instances (%d)", (int)(s->n / size) + n);
+	return ptr;
 }
 
 sg_pipeline
@@ -54,13 +43,22 @@ util_make_pipeline(sg_pipeline_desc *desc, util_shader_desc_func func, const cha
 	if (desc->layout.buffers[0].step_func == 0) {
 		desc->layout.buffers[0].step_func = SG_VERTEXSTEP_PER_INSTANCE;
 	}
-	if (blend) {
+	if (blend == UTIL_BLEND_PREMULTIPLIED) {
+		desc->colors[0].blend = (sg_blend_state) {
+			.enabled = true,
+			.src_factor_rgb = SG_BLENDFACTOR_ONE,
+			.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+			.src_factor_alpha = SG_BLENDFACTOR_ONE,
+			.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA
+		};
+	} else if (blend) {
 		desc->colors[0].blend = (sg_blend_state) {
 			.enabled = true,
 			.src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA,
 			.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+			// alpha of render targets (layers) accumulates, the color in them is premultiplied
 			.src_factor_alpha = SG_BLENDFACTOR_ONE,
-			.dst_factor_alpha = SG_BLENDFACTOR_ZERO
+			.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA
 		};
 	}
 	sg_pipeline pip = sg_make_pipeline(desc);
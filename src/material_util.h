@@ -4,13 +4,15 @@
 #include <lua.h>
 #include "sokol/sokol_gfx.h"
 #include "batch.h"
+#include "inststream.h"
 
 void util_ref_object(lua_State *L, void *ptr, int uv_index, const char *key, const char *luatype, int direct);
 
-typedef void (*util_submit_func)(lua_State *L, void *m_, struct draw_primitive *prim, int n);
-void util_submit_material(lua_State *L, int batch_n, void *mat, util_submit_func submit);
+void * util_inst_alloc(lua_State *L, struct inst_stream *s, int n, size_t size);
 
 typedef const sg_shader_desc* (*util_shader_desc_func)(sg_backend backend);
+// blend : 0 no blending, 1 alpha blending, UTIL_BLEND_PREMULTIPLIED for premultiplied alpha
+#define UTIL_BLEND_PREMULTIPLIED 2
 sg_pipeline util_make_pipeline(sg_pipeline_desc *desc, util_shader_desc_func func, const char *what, int blend);
 
 #endif
@@ -11,6 +11,7 @@
 #include "sprite_submit.h"
 #include "batch.h"
 #include "spritemgr.h"
+#include "inststream.h"
 
 #define UNIFORM_MAX 4
 #define BINDINGNAME_MAX 32
@@ -23,6 +24,11 @@ struct buffer {
 struct image {
 	sg_image img;
 	int size;
+	int mipmaps;
+	int width;
+	int height;
+	int pixel_size;
+	int compressed;	// 16 bytes per 4x4 block
 };
 
 struct sampler {
@@ -239,6 +245,10 @@ read_color_action(lua_State *L, int index, sg_pass_action *action, int idx) {
 		const char * key = lua_tostring(L, -1);
 		if (strcmp(key, "load") == 0) {
 			action->colors[idx].load_action = SG_LOADACTION_LOAD;
+		} else if (strcmp(key, "transparent") == 0) {
+			// clear to (0,0,0,0), an integer color without alpha is opaque
+			action->colors[idx].clear_value = (sg_color) { 0 };
+			action->colors[idx].load_action = SG_LOADACTION_CLEAR;
 		} else if (strcmp(key, "dontcare") == 0 ) {
 			action->colors[idx].load_action = SG_LOADACTION_DONTCARE;
 		} else {
@@ -366,19 +376,99 @@ lpass_new(lua_State *L) {
 	return 1;
 }
 
+static int
+lbackend(lua_State *L) {
+	const char *name;
+	switch (sg_query_backend()) {
+	case SG_BACKEND_GLCORE: name = "glcore"; break;
+	case SG_BACKEND_GLES3: name = "gles3"; break;
+	case SG_BACKEND_D3D11: name = "d3d11"; break;
+	case SG_BACKEND_METAL_IOS:
+	case SG_BACKEND_METAL_MACOS:
+	case SG_BACKEND_METAL_SIMULATOR: name = "metal"; break;
+	case SG_BACKEND_WGPU: name = "wgpu"; break;
+	case SG_BACKEND_DUMMY: name = "dummy"; break;
+	default: name = "unknown"; break;
+	}
+	lua_pushstring(L, name);
+	return 1;
+}
+
 static int
 lsubmit(lua_State *L) {
 	sg_commit();
 	return 0;
 }
 
+static int
+level_size(struct image *p, int level) {
+	int w = p->width >> level;
+	int h = p->height >> level;
+	if (w < 1)
+		w = 1;
+	if (h < 1)
+		h = 1;
+	if (p->compressed)
+		return ((w + 3) / 4) * ((h + 3) / 4) * 16;
+	return w * h * p->pixel_size;
+}
+
+// levels : { level0, level1, ... }, see level_size()
+static void
+read_mipmaps(lua_State *L, int index, struct image *p, sg_image_data *data) {
+	int i;
+	for (i=0;i<p->mipmaps;i++) {
+		int size = level_size(p, i);
+		const void *buffer;
+		switch (lua_rawgeti(L, index, i+1)) {
+		case LUA_TSTRING: {
+			size_t sz;
+			buffer = lua_tolstring(L, -1, &sz);
+			if (sz != (size_t)size)
+				luaL_error(L, "Invalid mipmap %d size %d != %d", i, (int)sz, size);
+			break; }
+		case LUA_TUSERDATA:
+		case LUA_TLIGHTUSERDATA:
+			buffer = lua_touserdata(L, -1);
+			break;
+		default:
+			luaL_error(L, "Need mipmap %d", i);
+			return;
+		}
+		// the buffer is referenced by the table
+		lua_pop(L, 1);
+		data->mip_levels[i].ptr = buffer;
+		data->mip_levels[i].size = size;
+	}
+}
+
+static int
+update_mipmaps(lua_State *L, struct image *p) {
+	sg_image_data data = { 0 };
+	read_mipmaps(L, 2, p, &data);
+	sg_update_image(p->img, &data);
+	return 0;
+}
+
 static int
 limage_update(lua_State *L) {
 	struct image *p = (struct image *)luaL_checkudata(L, 1, "SOKOL_IMAGE");
 	// todo: support subimage
-	void *buffer = lua_touserdata(L, 2);
-	if (buffer == NULL)
-		return luaL_error(L, "Need data");
+	if (p->mipmaps > 1) {
+		luaL_checktype(L, 2, LUA_TTABLE);
+		return update_mipmaps(L, p);
+	}
+	const void *buffer;
+	if (lua_type(L, 2) == LUA_TSTRING) {
+		size_t sz;
+		buffer = lua_tolstring(L, 2, &sz);
+		if (sz != (size_t)p->size)
+			return luaL_error(L, "Invalid image data size %d != %d", (int)sz, p->size);
+	} else {
+		buffer = lua_touserdata(L, 2);
+		if (buffer == NULL)
+			return luaL_error(L, "Need data");
+	}
 	sg_image_data data = {
 		.mip_levels[0].ptr = buffer,
 		.mip_levels[0].size = p->size,
@@ -398,10 +488,23 @@ get_pixel_format(lua_State *L, const char * type, int *pixel_size) {
 	} else if (strcmp(type, "DEPTH") == 0) {
 		*pixel_size = 0;
 		return SG_PIXELFORMAT_DEPTH;
+	} else if (strcmp(type, "BC3") == 0) {
+		*pixel_size = 0;
+		return SG_PIXELFORMAT_BC3_RGBA;
 	}
 	return luaL_error(L, "Invalid pixel format %s", type);
 }
 
+static int
+limage_release(lua_State *L) {
+	struct image *p = (struct image *)luaL_checkudata(L, 1, "SOKOL_IMAGE");
+	if (p->img.id != SG_INVALID_ID) {
+		sg_destroy_image(p->img);
+		p->img.id = SG_INVALID_ID;
+	}
+	return 0;
+}
+
 static int
 limage_ref(lua_State *L) {
 	struct image *p = (struct image *)lua_touserdata(L, 1);
@@ -449,14 +552,63 @@ limage(lua_State *L) {
 		img.usage.dynamic_update = 0;
 	}
 	lua_pop(L, 1);
-	// todo: type, render_target, num_slices, num_mipmaps, pixel_format, etc
+	if (lua_getfield(L, 1, "mipmaps") == LUA_TNUMBER) {
+		img.num_mipmaps = luaL_checkinteger(L, -1);
+		if (img.num_mipmaps < 1 || img.num_mipmaps > SG_MAX_MIPMAPS)
+			return luaL_error(L, "Invalid mipmaps %d", img.num_mipmaps);
+		if (img.width != img.height)
+			return luaL_error(L, "Mipmaps need a square image");
+	}
+	lua_pop(L, 1);
+	int compressed = (img.pixel_format == SG_PIXELFORMAT_BC3_RGBA);
+	// todo: type, render_target, num_slices, pixel_format, etc
 	struct image * p = (struct image *)lua_newuserdatauv(L, sizeof(*p), 0);
 	memset(p, 0, sizeof(*p));
+	p->width = img.width;
+	p->height = img.height;
+	p->pixel_size = pixel_size;
+	p->compressed = compressed;
+	p->mipmaps = img.num_mipmaps > 1 ? img.num_mipmaps : 1;
+	// .data : initial content, a table of mipmaps or a buffer of all the levels one after another.
+	// The image is immutable with it.
+	if (lua_getfield(L, 1, "data") != LUA_TNIL) {
+		img.usage.dynamic_update = 0;
+		img.usage.immutable = 1;
+		if (lua_type(L, -1) == LUA_TTABLE) {
+			read_mipmaps(L, -1, p, &img.data);
+		} else {
+			size_t sz = 0;
+			int i;
+			for (i=0;i<p->mipmaps;i++)
+				sz += level_size(p, i);
+			const char *buffer;
+			if (lua_type(L, -1) == LUA_TSTRING) {
+				size_t len;
+				buffer = lua_tolstring(L, -1, &len);
+				if (len != sz)
+					return luaL_error(L, "Invalid image data size %d != %d", (int)len, (int)sz);
+			} else {
+				buffer = (const char *)lua_touserdata(L, -1);
+				if (buffer == NULL)
+					return luaL_error(L, "Invalid .data");
+			}
+			for (i=0;i<p->mipmaps;i++) {
+				int size = level_size(p, i);
+				img.data.mip_levels[i].ptr = buffer;
+				img.data.mip_levels[i].size = size;
+				buffer += size;
+			}
+		}
+	} else if (compressed) {
+		return luaL_error(L, "Compressed image needs .data");
+	}
+	lua_pop(L, 1);
 	if (luaL_newmetatable(L, "SOKOL_IMAGE")) {
 		luaL_Reg l[] = {
 			{ "__index", NULL },
 			{ "__call", limage_ref },
 			{ "update", limage_update },
+			{ "release", limage_release },
 			{ NULL, NULL },
 		};
 		luaL_setfuncs(L, l, 0);
@@ -466,7 +618,17 @@ limage(lua_State *L) {
 	}
 	lua_setmetatable(L, -2);
 	p->img = sg_make_image(&img);
-	p->size = img.width * img.height * pixel_size;
+	p->size = level_size(p, 0);
+	return 1;
+}
+
+// returns true if the pixel format can be sampled by the backend
+static int
+lpixel_format(lua_State *L) {
+	int pixel_size;
+	sg_pixel_format fmt = get_pixel_format(L, luaL_checkstring(L, 1), &pixel_size);
+	sg_pixelformat_info info = sg_query_pixelformat(fmt);
+	lua_pushboolean(L, info.sample);
 	return 1;
 }
 
@@ -648,6 +810,68 @@ ltmp_buffer(lua_State *L) {
 	return 1;
 }
 
+static int
+linst_stream_reset(lua_State *L) {
+	struct inst_stream *s = (struct inst_stream *)luaL_checkudata(L, 1, "SOLUNA_INSTSTREAM");
+	s->n = 0;
+	s->flushed = 0;
+	return 0;
+}
+
+static int
+linst_stream_flush(lua_State *L) {
+	struct inst_stream *s = (struct inst_stream *)luaL_checkudata(L, 1, "SOLUNA_INSTSTREAM");
+	if (s->n > s->flushed) {
+		sg_append_buffer(s->buffer, &(sg_range) { s->data + s->flushed, s->n - s->flushed });
+		s->flushed = s->n;
+	}
+	return 0;
+}
+
+static int
+linst_stream_size(lua_State *L) {
+	struct inst_stream *s = (struct inst_stream *)luaL_checkudata(L, 1, "SOLUNA_INSTSTREAM");
+	lua_pushinteger(L, s->n);
+	return 1;
+}
+
+static int
+linst_stream(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	if (lua_getfield(L, 1, "buffer") != LUA_TUSERDATA)
+		return luaL_error(L, "Need .buffer");
+	struct buffer *b = (struct buffer *)luaL_checkudata(L, -1, "SOKOL_BUFFER");
+	if (!b->usage.stream_update)
+		return luaL_error(L, "Instance buffer should be stream usage");
+	if (lua_getfield(L, 1, "size") != LUA_TNUMBER)
+		return luaL_error(L, "Need .size");
+	size_t sz = luaL_checkinteger(L, -1);
+	lua_pop(L, 1);
+	struct inst_stream *s = (struct inst_stream *)lua_newuserdatauv(L, sizeof(*s) - 1 + sz, 1);
+	s->buffer = b->handle;
+	s->cap = sz;
+	s->n = 0;
+	s->flushed = 0;
+	// ref buffer object
+	lua_pushvalue(L, -2);
+	lua_setiuservalue(L, -2, 1);
+	if (luaL_newmetatable(L, "SOLUNA_INSTSTREAM")) {
+		luaL_Reg l[] = {
+			{ "__index", NULL },
+			{ "__len", linst_stream_size },
+			{ "reset", linst_stream_reset },
+			{ "flush", linst_stream_flush },
+			{ NULL, NULL },
+		};
+		luaL_setfuncs(L, l, 0);
+
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -2, "__index");
+	}
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
 int lbindings_new(lua_State *L);
 int lview_new(lua_State *L);
 int luniform_new(lua_State *L);
@@ -658,6 +882,8 @@ luaopen_render(lua_State *L) {
 	luaL_Reg l[] = {
 		{ "pass", lpass_new },
 		{ "submit", lsubmit },
+		{ "backend", lbackend },
+		{ "pixel_format", lpixel_format },
 		{ "image", limage },
 		{ "buffer", lbuffer },
 		{ "sampler", lsampler },
@@ -668,6 +894,7 @@ luaopen_render(lua_State *L) {
 		{ "view", lview_new },
 		{ "uniform", luniform_new },
 		{ "tmp_buffer", ltmp_buffer },
+		{ "inst_stream", linst_stream },
 		{ NULL, NULL },
 	};
 	luaL_newlib(L, l);
@@ -202,6 +202,7 @@ lview_new(lua_State *L) {
 			{ "__tostring", lview_tostring },
 			{ "__gc", lview_release },
 			{ "__call", lview_getptr },
+			{ "release", lview_release },
 			{ NULL, NULL },
 		};
 		luaL_setfuncs(L, l, 0);
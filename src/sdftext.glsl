@@ -1,3 +1,5 @@
+@include srdecode.glsl
+
 @vs vs
 layout(binding=0) uniform vs_params {
 	vec2 framesize;
@@ -16,8 +18,10 @@ in vec3 position;
 in uint offset;
 in uint u;
 in uint v;
+in uint color;
 
 out vec2 uv;
+out vec4 c;
 
 void main() {
 	ivec2 uv_base = ivec2(u >> 16, v >> 16);
@@ -26,8 +30,50 @@ void main() {
 	ivec2 off = ivec2(offset >> 16 , offset & 0xffff) - 0x8000;
 	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
 	vec2 pos = ((uv_offset - off) * sr[int(position.z)].m + position.xy) * framesize;
-	gl_Position = vec4(pos.x - 1.0f, pos.y + 1.0f, 0, 1);
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
+	uv = (uv_base + uv_offset) * texsize;
+	c = vec4(
+		float((color >> 16) & 0xff) / 255.0f,
+		float((color >> 8) & 0xff) / 255.0f,
+		float((color) & 0xff) / 255.0f,
+		float((color >> 24) & 0xff) / 255.0f);
+}
+
+@end
+
+// sr is decoded in vertex shader, no sr buffer
+@vs vs_direct
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+	float texsize;
+};
+
+@include_block sr_decode
+
+in vec2 position;
+in uint sr;
+in uint offset;
+in uint u;
+in uint v;
+in uint color;
+
+out vec2 uv;
+out vec4 c;
+
+void main() {
+	ivec2 uv_base = ivec2(u >> 16, v >> 16);
+	ivec2 u2 = ivec2(0 , u & 0xffff);
+	ivec2 v2 = ivec2(0 , v & 0xffff);
+	ivec2 off = ivec2(offset >> 16 , offset & 0xffff) - 0x8000;
+	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
+	vec2 pos = ((uv_offset - off) * sr_decode(sr) + position.xy) * framesize;
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
 	uv = (uv_base + uv_offset) * texsize;
+	c = vec4(
+		float((color >> 16) & 0xff) / 255.0f,
+		float((color >> 8) & 0xff) / 255.0f,
+		float((color) & 0xff) / 255.0f,
+		float((color >> 24) & 0xff) / 255.0f);
 }
 
 @end
@@ -39,25 +85,20 @@ layout(binding=0) uniform sampler smp;
 layout(binding=1) uniform fs_params {
 	float edge_mask;
 	float dist_multiplier;
-	int color;
-	float unused;
+	vec2 unused;
 };
 
 in vec2 uv;
+in vec4 c;
 out vec4 frag_color;
 
 void main() {
 	float dis = texture(sampler2D(tex,smp), uv).r;
 	float smoothing = length(fwidth(uv)) * 128.0 * dist_multiplier;
 	float alpha = smoothstep(edge_mask - smoothing, edge_mask + smoothing, dis);
-	float color_alpha = ((color >> 24) & 0xff) / 255.0f;
-	vec4 c = vec4(
-		((color >> 16) & 0xff) / 255.0f,
-		((color >> 8) & 0xff) / 255.0f,
-		((color) & 0xff) / 255.0f,
-		color_alpha * alpha);
-	frag_color = c;
+	frag_color = vec4(c.rgb, c.a * alpha);
 }
 @end
 
-@program texquad vs fs
\ No newline at end of file
+@program texquad vs fs
+@program texquad_direct vs_direct fs
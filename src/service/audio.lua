@@ -10,11 +10,16 @@ local definitions = {}
 local groups = {}
 local voices = {}
 local bundles = {}
+-- decoded samples of non-stream sounds, and idle voices of them : pools[name][group] = { voice, ... }
+local samples = {}
+local pools = {}
+local voice_pool = {}
 local next_voice_id_value = 0
 local ziplist
 local is_quit
 
 local SOUND_FLAG_STREAM = 0x00000001
+local POOL_SIZE <const> = 32
 local DEFAULT_DEFINITION = {
 	group = "sound",
 	volume = 1.0,
@@ -96,8 +101,52 @@ local function release_voice(id)
 	if not voice then
 		return
 	end
-	audio.sound_uninit(voice)
 	voices[id] = nil
+	local pool = voice_pool[id]
+	if pool then
+		voice_pool[id] = nil
+		if #pool < POOL_SIZE then
+			audio.sound_reset(voice)
+			pool[#pool+1] = voice
+			return
+		end
+	end
+	audio.sound_uninit(voice)
+end
+
+local function get_pool(name, group)
+	local p = pools[name]
+	if p == nil then
+		p = {}
+		pools[name] = p
+	end
+	local pool = p[group]
+	if pool == nil then
+		pool = {}
+		p[group] = pool
+	end
+	return pool
+end
+
+local function new_voice(name, final, group)
+	local sample = not final.stream and samples[name]
+	if sample then
+		local pool = get_pool(name, final.group)
+		local n = #pool
+		if n > 0 then
+			local voice = pool[n]
+			pool[n] = nil
+			return voice, pool
+		end
+		local voice, err = audio.sound_copy(device, sample, group)
+		if not voice then
+			return nil, nil, err
+		end
+		return voice, pool
+	end
+	local flags = final.stream and SOUND_FLAG_STREAM or 0
+	local voice, err = audio.sound_init(device, final.filename, flags, group)
+	return voice, nil, err
 end
 
 local function cleanup_voices()
@@ -155,6 +204,10 @@ function S.init(filename)
 			groups[def.group] = group
 		end
 		definitions[name] = def
+		if not def.stream then
+			-- fallback to sound_init when the sample can't be decoded
+			samples[name] = audio.sample_init(device, def.filename)
+		end
 	end
 	bundles[filename] = true
 end
@@ -171,9 +224,7 @@ function S.play_sound(name, opts)
 		return nil, "Unknown audio bus " .. tostring(final.group)
 	end
 
-	local flags = final.stream and SOUND_FLAG_STREAM or 0
-
-	local voice, err = audio.sound_init(device, final.filename, flags, group)
+	local voice, pool, err = new_voice(name, final, group)
 	if not voice then
 		return nil, err
 	end
@@ -191,6 +242,7 @@ function S.play_sound(name, opts)
 
 	local id = next_voice_id()
 	voices[id] = voice
+	voice_pool[id] = pool
 	return id
 end
 
@@ -270,6 +322,21 @@ function S.voice_tell(id)
 	return audio.sound_tell(voice)
 end
 
+-- buf : packed (voice id, op, value) records from soluna.audio_batch(), sent without reply
+function S.voice_commands(buf)
+	audio.sound_commands(voices, buf)
+end
+
+function S.voice_query(ids)
+	local playing, seconds = audio.sound_query(voices, ids)
+	for i = 1, #ids do
+		if not playing[i] then
+			release_voice(ids[i])
+		end
+	end
+	return playing, seconds
+end
+
 function S.bus_set_volume(name, volume)
 	local group = groups[name]
 	if group == nil then
@@ -281,8 +348,22 @@ end
 
 function S.quit()
 	is_quit = true
-	for id in pairs(voices) do
-		release_voice(id)
+	for id, voice in pairs(voices) do
+		audio.sound_uninit(voice)
+		voices[id] = nil
+	end
+	voice_pool = {}
+	for _, p in pairs(pools) do
+		for _, pool in pairs(p) do
+			for i = 1, #pool do
+				audio.sound_uninit(pool[i])
+			end
+		end
+	end
+	pools = {}
+	for name, sample in pairs(samples) do
+		audio.sample_uninit(sample)
+		samples[name] = nil
 	end
 	for name, group in pairs(groups) do
 		audio.group_uninit(group)
@@ -1,64 +1,248 @@
+local ltask = require "ltask"
 local image = require "soluna.image"
 local spritemgr = require "soluna.spritemgr"
 local spritebundle = require "soluna.spritebundle"
+local atlascache = require "soluna.atlascache"
+local atlasjob = require "soluna.atlasjob"
+local util = require "soluna.util"
 
-global setmetatable, ipairs, pairs, assert, type
+global setmetatable, ipairs, pairs, assert, type, rawget, pcall, error
 
 local sprite_bank
+local atlas_cache
+local texture_size
+local compact_ratio
+local mipmap
+-- premultiply alpha of texture pages
+local premultiply
+-- block compressed format of texture pages ("BC3"), set by render service
+local compress
+local worker_n = 0
+local workers
+-- bundle loaded from source, waiting for S.bake
+local baking
 
--- todo: make weak table
+-- decoded images, released when no live sprite is cropped from them (see file_ref)
 local filecache = setmetatable({ __missing = {}} , { __index = spritebundle.loadimage })
+-- image filename -> number of live sprites cropped from it
+local file_ref = {}
+-- images from S.preload can't be loaded again, keep them
+local preloaded = {}
 
 local S = {}
 
 function S.init(config)
-	sprite_bank = spritemgr.newbank(config.max_sprite, config.texture_size)
+	mipmap = config.mipmap or 0
+	premultiply = config.premultiply or false
+	sprite_bank = spritemgr.newbank(config.max_sprite, config.texture_size, mipmap)
+	texture_size = config.texture_size
+	compact_ratio = config.compact or 0
+	worker_n = config.worker or 0
+	if config.atlas_cache then
+		atlas_cache = {
+			path = config.atlas_cache,
+			level = config.atlas_cache_level,
+			texture_size = config.texture_size,
+		}
+	end
 	return sprite_bank:ptr()
 end
 
+-- filename -> { sprites = bundle, ids = sprite ids, ref = reference count }
 local bundle = {}
 local sprite = {}
 
+local function add_sprite(obj, ids)
+	local id = sprite_bank:add(obj.cw, obj.ch, obj.x, obj.y)
+	sprite[id] = obj
+	ids[#ids+1] = id
+	local fname = obj.filename
+	file_ref[fname] = (file_ref[fname] or 0) + 1
+	return id
+end
+
+-- returns bundle and sprite ids
 local function add_list(desc)
 	local b = {}
+	local ids = {}
 	for _, item in ipairs(desc) do
 		local n = #item
 		if n == 0 then
-			local id = sprite_bank:add(item.cw, item.ch, item.x, item.y)
+			local id = add_sprite(item, ids)
 			item.id = id
-			sprite[id] = item
 			b[item.name] = id
 		else
 			local pack = {}
 			b[item.name] = pack
 			for i = 1, n do
-				local s = item[i]
-				local id = sprite_bank:add(s.cw, s.ch, s.x, s.y)
-				sprite[id] = s
-				pack[i] = id
+				pack[i] = add_sprite(item[i], ids)
+			end
+		end
+	end
+	return b, ids
+end
+
+local function remove_list(ids)
+	for _, id in ipairs(ids) do
+		sprite_bank:remove(id)
+		local fname = sprite[id].filename
+		sprite[id] = nil
+		local ref = file_ref[fname] - 1
+		if ref == 0 then
+			file_ref[fname] = nil
+			if not preloaded[fname] then
+				filecache[fname] = nil
 			end
+		else
+			file_ref[fname] = ref
 		end
 	end
-	return b
+end
+
+-- Compact when a texture (except the last one, which is repacked by each load) has no live sprite,
+-- or the live sprites use less than compact_ratio of the textures.
+local function need_compact()
+	local pages = sprite_bank:pages()
+	local n = #pages
+	local used = 0
+	for i = 1, n do
+		local area = pages[i]
+		if area == 0 and i < n then
+			return true
+		end
+		used = used + area
+	end
+	return n > 1 and used < compact_ratio * (n - 1) * texture_size * texture_size
+end
+
+local function get_workers()
+	if workers == nil then
+		workers = {}
+		for i = 1, worker_n do
+			workers[i] = ltask.spawn "loaderworker"
+		end
+	end
+	return workers
+end
+
+-- Run f(i, worker) for i in [1, n] in forked coroutines, worker is the loader worker of the i-th job.
+-- Returns after all of them finish, and raises the first error.
+local function fanout(n, f)
+	local w = get_workers()
+	local token = ltask.current_token()
+	local rest = n
+	local err
+	for i = 1, n do
+		ltask.fork(function()
+			local ok, e = pcall(f, i, w[(i-1) % #w + 1])
+			if not ok then
+				err = err or e
+			end
+			rest = rest - 1
+			if rest == 0 then
+				ltask.wakeup(token)
+			end
+		end)
+	end
+	ltask.wait()
+	if err then
+		error(err)
+	end
+end
+
+-- Decode and crop images in worker services, one job per image file.
+-- Results are put back by index, so the sprite ids are the same as loading in sequence.
+local function crop_parallel(desc)
+	local jobs = {}
+	local files = {}
+	local rest = {}
+	for idx, item in ipairs(desc) do
+		local fname = item.filename
+		if rawget(filecache, fname) then
+			-- decoded or preloaded
+			rest[#rest+1] = item
+		else
+			local job = files[fname]
+			if job == nil then
+				job = { filename = fname, index = {}, items = {} }
+				files[fname] = job
+				jobs[#jobs+1] = job
+			end
+			job.index[#job.index+1] = idx
+			job.items[#job.items+1] = item
+		end
+	end
+	if #jobs < 2 or worker_n < 2 then
+		return spritebundle.crop(filecache, desc)
+	end
+	fanout(#jobs, function(i, worker)
+		local job = jobs[i]
+		local c, items = ltask.call(worker, "load", job.filename, job.items)
+		if c then
+			filecache[job.filename] = c
+			for j, idx in ipairs(job.index) do
+				desc[idx] = items[j]
+			end
+			job.items = nil
+		end
+	end)
+	for _, job in ipairs(jobs) do
+		-- missing image, crop raises the error
+		local items = job.items
+		if items then
+			for _, item in ipairs(items) do
+				rest[#rest+1] = item
+			end
+		end
+	end
+	spritebundle.crop(filecache, rest)
+	return desc
+end
+
+local function load_file(filename, b)
+	local desc = spritebundle.parse(filename)
+	local n, _, _, live = sprite_bank:stat()
+	-- the rects of removed sprites can't be restored, skip the atlas cache after any unloading
+	if atlas_cache and n == live then
+		local key = atlascache.key(filename, desc, sprite_bank, filecache, atlas_cache.texture_size, mipmap, compress, premultiply)
+		local cachefile = atlascache.filename(atlas_cache.path, filename)
+		local c = atlascache.load(cachefile, key)
+		if c then
+			b.sprites, b.ids = add_list(c.desc)
+			sprite_bank:restore(c.rects, c.texture_n)
+			return c.pages
+		end
+		baking = { cachefile = cachefile, key = key, desc = desc }
+	end
+	crop_parallel(desc)
+	b.sprites, b.ids = add_list(desc)
 end
 
 local function load_from_file(filename)
 	local b = bundle[filename]
 	if b then
-		return b
+		b.ref = b.ref + 1
+		return b.sprites
 	end
-	local desc = spritebundle.load(filecache, filename)
-	local b = add_list(desc)
+	-- loads are serialized by bundle_lock, record it after it's loaded
+	b = { ref = 1 }
+	local pages = load_file(filename, b)
 	bundle[filename] = b
-	return b
+	return b.sprites, pages
 end
 
 local function load_from_table(t)
-	local desc = spritebundle.load(filecache, t, t.path)
-	return add_list(desc)
+	local desc = spritebundle.parse(t, t.path)
+	return (add_list(crop_parallel(desc)))
 end
 
-function S.loadbundle(filename)
+-- loadbundle and unloadbundle yield for worker jobs, they are serialized, so an unloading never releases
+-- the images in filecache being cropped, and baking belongs to the last loading.
+-- The render service serializes load_sprites / unload_sprites too, they call S.pack, S.blit and S.bake after it.
+local bundle_lock = util.lock()
+
+local function loadbundle(filename)
+	baking = nil
 	if type(filename) == "table" then
 		return load_from_table(filename)
 	else
@@ -66,11 +250,14 @@ function S.loadbundle(filename)
 	end
 end
 
-function S.pack()
-	local texid, n = sprite_bank:pack()
-	-- upload rects into n textures, [texid, texid + n)
+-- returns bundle, and texture pages when it's restored from atlas cache
+function S.loadbundle(filename)
+	return bundle_lock(loadbundle, filename)
+end
+
+-- upload rects into n textures, [texid, texid + n)
+local function pack_results(texid, n)
 	local results = {}
-	local texid_from = texid
 	for i = 1, n do
 		local r = sprite_bank:altas(texid)
 		for id,v in pairs(r) do
@@ -85,9 +272,153 @@ function S.pack()
 		texid = texid + 1
 		results[i] = r
 	end
+	return results
+end
+
+function S.pack()
+	local texid_from, n = sprite_bank:pack()
+	local results = pack_results(texid_from, n)
+	if baking then
+		baking.from = texid_from
+	end
 	return results, texid_from
 end
 
+local function unloadbundle(name)
+	local ids
+	if type(name) == "table" then
+		ids = {}
+		for _, v in pairs(name) do
+			if type(v) == "table" then
+				for _, id in ipairs(v) do
+					ids[#ids+1] = id
+				end
+			else
+				ids[#ids+1] = v
+			end
+		end
+	else
+		local b = bundle[name]
+		if b == nil then
+			error("Bundle " .. name .. " is not loaded")
+		end
+		b.ref = b.ref - 1
+		if b.ref > 0 then
+			return false
+		end
+		bundle[name] = nil
+		ids = b.ids
+	end
+	remove_list(ids)
+	return need_compact()
+end
+
+-- name : filename, or the bundle returned by loading a table.
+-- Bundles from file are reference counted, the sprites are removed when the last reference is unloaded.
+-- returns true when the textures should be compacted by S.compact
+function S.unloadbundle(name)
+	return bundle_lock(unloadbundle, name)
+end
+
+-- Run job(texture_size, pages[i]) for each texture page (or band of page), one worker command per page.
+-- job is from soluna.atlasjob, cmd is the command of loaderworker running the same job.
+-- Returns the results by index.
+local function page_jobs(pages, cmd, job)
+	local n = #pages
+	local results = {}
+	if n < 2 or worker_n < 2 then
+		for i = 1, n do
+			results[i] = job(texture_size, pages[i])
+		end
+		return results
+	end
+	fanout(n, function(i, worker)
+		results[i] = ltask.call(worker, cmd, texture_size, pages[i])
+	end)
+	return results
+end
+
+-- pages : { ptr, list } of each texture, list is from image.blit_list().
+-- Each texture is split into horizontal bands, one job per band in loader workers.
+function S.blit(pages)
+	local bands = worker_n < 2 and 1 or worker_n
+	local height = (texture_size + bands - 1) // bands
+	-- the rects are apart by at least one mipmap block (>= 2 pixels), so they can be extruded
+	local extrude = mipmap > 0
+	local jobs = {}
+	for i = 1, #pages do
+		local ptr, list = pages[i][1], pages[i][2]
+		for y = 0, texture_size - 1, height do
+			jobs[#jobs+1] = {
+				ptr = ptr,
+				list = list,
+				y0 = y,
+				y1 = y + height,
+				premultiply = premultiply,
+				extrude = extrude,
+			}
+		end
+	end
+	page_jobs(jobs, "blit", atlasjob.blit)
+end
+
+-- pages : the mipmap chain of each texture, { level0, level1, ... } pointers.
+-- Generate the levels from level0, one job per texture in loader workers
+function S.mipmap(pages)
+	for i = 1, #pages do
+		pages[i].premultiply = premultiply
+	end
+	page_jobs(pages, "mipmap", atlasjob.mipmap)
+end
+
+function S.texture_format(format)
+	compress = format
+end
+
+-- pages : the same as S.mipmap, returns the compressed mipmap chain of each texture, all levels in one string
+function S.compress(pages)
+	return page_jobs(pages, "compress", atlasjob.compress)
+end
+
+-- A sprite shows the texture of a cached layer, see render S.layer_new
+function S.layer_new(w, h, texid)
+	local id = sprite_bank:add(w, h)
+	sprite_bank:layer(id, texid)
+	return id
+end
+
+function S.layer_remove(id)
+	sprite_bank:remove(id)
+end
+
+-- Repack live sprites into textures [texid, texid + n), the textures after them are empty
+function S.compact()
+	local texid, n = sprite_bank:compact()
+	return pack_results(texid, n), texid
+end
+
+-- rects and texture number of the sprite bank, for frame capture
+function S.dump()
+	return sprite_bank:dump()
+end
+
+-- sprite ids used, rects reserved, sprite_max, live sprites
+function S.stat()
+	return sprite_bank:stat()
+end
+
+-- pages : pointers of texture pages [from, from + #pages) just packed,
+-- or the strings from S.compress when the pages are compressed
+function S.bake(pages)
+	local b = baking
+	baking = nil
+	if b == nil or b.from == nil then
+		return
+	end
+	local page_size = atlas_cache.texture_size * atlas_cache.texture_size * 4
+	return atlascache.save(b.cachefile, b.key, b.desc, sprite_bank, b.from, pages, page_size, atlas_cache.level)
+end
+
 function S.write(id, filename)
 	local obj = sprite[id]
 	assert(obj.cx)
@@ -101,6 +432,7 @@ end
 function S.preload(filename, content, w, h)
 	assert(#content == w * h * 4)
 	filecache[filename] = { data = content, w = w, h = h }
+	preloaded[filename] = true
 end
 
 return S
\ No newline at end of file
@@ -0,0 +1,24 @@
+local spritebundle = require "soluna.spritebundle"
+local atlasjob = require "soluna.atlasjob"
+
+global none
+
+local S = {}
+
+-- decode one image and crop all the items refer to it, see loader.lua
+function S.load(filename, items)
+	local filecache = { __missing = {} }
+	local c = spritebundle.loadimage(filecache, filename)
+	if c == nil then
+		return
+	end
+	spritebundle.crop(filecache, items)
+	return c, items
+end
+
+-- page jobs of loader.lua, see soluna.atlasjob
+S.blit = atlasjob.blit
+S.mipmap = atlasjob.mipmap
+S.compress = atlasjob.compress
+
+return S
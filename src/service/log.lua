@@ -1,6 +1,5 @@
 local ltask = require "ltask"
 local writelog = require "soluna.log"
-local io = io
 
 global none
 
@@ -8,15 +7,13 @@ local S = {}
 
 local sokol_log = writelog.sokol
 local ltask_log = writelog.ltask
+local flush = writelog.flush
+local logfile = writelog.file
 
 local function writelog()
-	local flush
 	while true do
 		local ti, id, msg, sz = ltask.poplog()
 		if ti == nil then
-			if flush then
-				io.flush()
-			end
 			break
 		end
 		if id == 0 then
@@ -24,8 +21,8 @@ local function writelog()
 		else
 			ltask_log(ti, ltask.unpack_remove(msg, sz))
 		end
-		flush = true
 	end
+	flush()
 end
 
 ltask.fork(function()
@@ -35,8 +32,15 @@ ltask.fork(function()
 	end
 end)
 
+-- rotating log file, nil filename closes it
+function S.file(filename, rotate_size, rotate_count)
+	writelog()
+	logfile(filename, rotate_size, rotate_count)
+end
+
 function S.quit()
 	writelog()
+	logfile()
 end
 
 return S
@@ -3,9 +3,17 @@ local render = require "soluna.render"
 local image = require "soluna.image"
 local embedsource = require "soluna.embedsource"
 local drawmgr = require "soluna.drawmgr"
+local spritemgr = require "soluna.spritemgr"
 local file = require "soluna.file"
+local trace = require "soluna.trace"
+local capturelib = require "soluna.capture"
+local arena = require "soluna.arena"
+local util = require "soluna.util"
+local table = table
+local string = string
+local math = math
 
-global require, assert, pairs, pcall, ipairs, print, load, type
+global require, assert, pairs, pcall, ipairs, print, load, type, error
 
 local setting = require "soluna".settings()
 
@@ -13,6 +21,7 @@ local font = {}
 
 local function create_materials(ctx)
 	local materials = {}
+	local names = {}
 
 	local function load_material(source, chunkname, id)
 		local chunk = assert(load(source, chunkname))
@@ -29,6 +38,7 @@ local function create_materials(ctx)
 		assert(type(material.submit) == "function", chunkname .. " : missing submit function")
 		assert(type(material.draw) == "function", chunkname .. " : missing draw function")
 		materials[id] = material
+		names[#names+1] = id .. " " .. chunkname
 	end
 
 	local MATERIAL_EXTLUA_BASE <const> = 256
@@ -56,7 +66,7 @@ local function create_materials(ctx)
 			load_material(file.load(fullname), "@" .. fullname, id)
 		end
 	end
-	return materials
+	return materials, table.concat(names, "\n")
 end
 
 do
@@ -134,6 +144,50 @@ end
 
 local STATE
 
+-- Frame capture (setting frame_capture) writes the batch streams of each frame into a file,
+-- frame replay (setting frame_replay) draws the captured streams instead of the streams from the game.
+local capture = {}
+
+local function capture_init()
+	if setting.frame_capture then
+		capture.writer = capturelib.writer(setting.frame_capture, STATE.material_names)
+		capture.streams = {}
+	elseif setting.frame_replay then
+		local reader = capturelib.reader(setting.frame_replay)
+		if reader:header() ~= STATE.material_names then
+			error "Materials mismatch in frame replay file"
+		end
+		capture.reader = reader
+		capture.streams = {}
+		capture.index = 0
+		capture.loop = setting.frame_replay_loop or 1
+		capture.time = 0
+	end
+end
+
+local function capture_check_bank()
+	local loader = ltask.uniqueservice "loader"
+	local rects = ltask.call(loader, "dump")
+	local _, capture_rects = capture.reader:header()
+	if rects ~= capture_rects then
+		error "Sprite bank mismatch, load the same sprite bundles before frame replay"
+	end
+	capture.checked = true
+end
+
+local function capture_close()
+	local writer = capture.writer
+	if writer then
+		capture.writer = nil
+		local ok, rects, texture_n = pcall(ltask.call, ltask.uniqueservice "loader", "dump")
+		if ok then
+			writer:close(rects, texture_n)
+		else
+			writer:close("", 0)
+		end
+	end
+end
+
 local S = {}
 
 function S.app(settings)
@@ -146,47 +200,226 @@ function S.app(settings)
 	end
 end
 
--- todo: update mutiple images
 local update_image
+-- tokens waiting for update_image, see wait_update_image()
+local update_waiting = {}
 
-local function delay_update_image(imgmem)
+-- page_n : drop the textures after page_n, they have no sprites after compaction.
+-- The rects repacked by the compaction are committed with the textures.
+local function delay_update_image(imgmem, page_n)
+	local prev = update_image
 	function update_image()
+		if prev then
+			prev()
+		end
+		if page_n and spritemgr.commit(STATE.bank_ptr) then
+			STATE.sprite_dirty = true
+		end
 		local from = imgmem.from
 		for i = 1, #imgmem do
 			local tid = from + i
 			local tex = STATE.textures[tid]
-			if tex == nil then
+			if STATE.compress then
+				-- compressed textures are immutable, replace them
+				if tex then
+					STATE.views[tid]:release()
+					tex:release()
+				end
 				local texture_size = setting.texture_size
 				tex = render.image {
 					width = texture_size,
 					height = texture_size,
+					pixel_format = STATE.compress,
+					mipmaps = setting.atlas_mipmap > 0 and setting.atlas_mipmap + 1 or nil,
+					data = imgmem[i],
 				}
 				STATE.textures[tid] = tex
 				STATE.views[tid] = render.view { texture = tex }
+			else
+				if tex == nil then
+					local texture_size = setting.texture_size
+					tex = render.image {
+						width = texture_size,
+						height = texture_size,
+						mipmaps = setting.atlas_mipmap > 0 and setting.atlas_mipmap + 1 or nil,
+					}
+					STATE.textures[tid] = tex
+					STATE.views[tid] = render.view { texture = tex }
+				end
+				tex:update(imgmem[i])
+			end
+		end
+		if page_n then
+			local textures = STATE.textures
+			for tid = #textures, page_n + 1, -1 do
+				STATE.views[tid]:release()
+				STATE.views[tid] = nil
+				textures[tid]:release()
+				textures[tid] = nil
 			end
-			tex:update(imgmem[i])
 		end
 		update_image = nil
 	end
 end
 
+-- Wait until the textures of delay_update_image() are uploaded in a frame
+local function wait_update_image()
+	if update_image then
+		update_waiting[#update_waiting+1] = ltask.current_token()
+		ltask.wait()
+	end
+end
+
+local function wakeup_update_waiting()
+	if update_image == nil and update_waiting[1] then
+		for i = 1, #update_waiting do
+			ltask.wakeup(update_waiting[i])
+			update_waiting[i] = nil
+		end
+	end
+end
+
+-- Cached layers, texid -> layer. The content of a layer is drawn into its render target
+-- only after S.layer_update, and the layer is drawn as a sprite bound to the target.
+local layers = {}
+local LAYER_TEXTUREID <const> = 0x8000
+
+local function create_layer(layer)
+	-- the target is square because the uv of sprites are scaled by the single tex_size uniform
+	local size = layer.size
+	local color = render.image {
+		width = size,
+		height = size,
+		color_attachment = true,
+		label = "layer-color",
+	}
+	local depth = render.image {
+		width = size,
+		height = size,
+		depth_stencil_attachment = true,
+		label = "layer-depth",
+	}
+	layer.color = color
+	layer.depth = depth
+	layer.color_view = render.view { color_attachment = color }
+	layer.depth_view = render.view { depth_stencil_attachment = depth }
+	layer.pass = render.pass {
+		color0 = "transparent",
+		attachment = {
+			color0 = layer.color_view,
+			depth_stencil = layer.depth_view,
+		},
+	}
+	layer.framesize = { 2 / size, STATE.layer_flip * 2 / size }
+	layer.tex_size = 1 / size
+	STATE.views[layer.texid + 1] = render.view { texture = color }
+end
+
+local function release_layers()
+	for texid, layer in pairs(layers) do
+		if layer.release then
+			layers[texid] = nil
+			STATE.views[texid + 1]:release()
+			STATE.views[texid + 1] = nil
+			layer.color_view:release()
+			layer.depth_view:release()
+			layer.color:release()
+			layer.depth:release()
+		end
+	end
+end
+
+-- append the content of dirty layers, returns { layer, first draw, last draw } list
+local function layer_append()
+	local draws
+	for _, layer in pairs(layers) do
+		if layer.dirty then
+			layer.dirty = nil
+			local from = #STATE.drawmgr
+			if layer.ptr then
+				STATE.drawmgr:append(layer.ptr, layer.n)
+				layer.ptr = nil
+			end
+			draws = draws or {}
+			draws[#draws+1] = { layer, from + 1, #STATE.drawmgr }
+		end
+	end
+	return draws
+end
+
+-- Draw an object of drawmgr, the uv of sprites in a layer are scaled by the size of its target
+local function draw_object(i)
+	local mat, ptr, n, tex = STATE.drawmgr(i)
+	local obj = assert(STATE.materials[mat])
+	local layer = layers[tex]
+	if layer then
+		local uniform = STATE.uniform
+		uniform.tex_size = layer.tex_size
+		obj.draw(ptr, n, tex)
+		uniform.tex_size = STATE.tex_size
+	else
+		obj.draw(ptr, n, tex)
+	end
+end
+
+-- The content of layers are blended as premultiplied alpha (see util_make_pipeline),
+-- the default material composites the layer textures with premultiplied blending.
+local function draw_layers(draws)
+	local uniform = STATE.uniform
+	for _, d in ipairs(draws) do
+		local layer = d[1]
+		uniform.framesize = layer.framesize
+		layer.pass:begin()
+		for i = d[2], d[3] do
+			draw_object(i)
+		end
+		layer.pass:finish()
+	end
+	uniform.framesize = STATE.framesize
+end
+
 local function frame(count)
 	local batch_size = setting.batch_size
 
 	-- todo: do not wait all batch commits
 	local batch_n = #batch
 	if update_image then update_image() end
+	release_layers()
 	STATE.drawmgr:reset()
 	for _, obj in pairs(STATE.materials) do
 		if obj.reset then
 			obj.reset()
 		end
 	end
-
-	for i = 1, batch_n do
-		local ptr, size = batch[i][1]()
-		if ptr then
-			STATE.drawmgr:append(ptr, size)
+	-- layers are submitted and drawn first, the materials draw in the order of submit
+	local layer_draws = layer_append()
+	local main_from = #STATE.drawmgr + 1
+
+	local reader = capture.reader
+	if reader then
+		capture.index = capture.index % #reader + 1
+		local streams = capture.streams
+		local n = reader:frame(capture.index, streams)
+		for i = 1, n do
+			STATE.drawmgr:append(streams[i*2-1], streams[i*2])
+		end
+	else
+		local writer = capture.writer
+		local n = 0
+		for i = 1, batch_n do
+			local ptr, size = batch[i][1]()
+			if ptr then
+				STATE.drawmgr:append(ptr, size)
+				if writer then
+					local streams = capture.streams
+					n = n + 1
+					streams[n*2-1] = ptr
+					streams[n*2] = size
+				end
+			end
+		end
+		if writer then
+			writer:frame(capture.streams, n)
 		end
 	end
 	local draw_n = #STATE.drawmgr
@@ -195,24 +428,57 @@ local function frame(count)
 		local obj = assert(STATE.materials[mat])
 		obj.submit(ptr, n)
 	end
+	for _, obj in pairs(STATE.materials) do
+		if obj.flush then
+			obj.flush()
+		end
+	end
 	STATE.srbuffer:update(STATE.srbuffer_mem:ptr())
-	STATE.pass:begin()
 	font.submit(STATE.font_texture)
-	for i = 1, draw_n do
-		local mat, ptr, n, tex = STATE.drawmgr(i)
-		local obj = assert(STATE.materials[mat])
-		obj.draw(ptr, n, tex)
+	if layer_draws then
+		draw_layers(layer_draws)
+	end
+	STATE.pass:begin()
+	for i = main_from, draw_n do
+		draw_object(i)
 	end
 	STATE.pass:finish()
 	render.submit()
 end
 
+local function replay_frame(count)
+	if not capture.checked then
+		capture_check_bank()
+	end
+	local t = ltask.counter()
+	local ok, err = pcall(ltask.mainthread_run, frame, count)
+	capture.time = capture.time + ltask.counter() - t
+	local n = #capture.reader
+	if capture.index == n then
+		print(string.format("Frame replay : %d frames, %.3f ms per frame", n, capture.time * 1000 / n))
+		capture.time = 0
+		capture.loop = capture.loop - 1
+		if capture.loop == 0 then
+			require "soluna.app".quit()
+		end
+	end
+	return ok, err
+end
+
 function S.frame(count)
 	batch.wait()
-	local ok, err = pcall(ltask.mainthread_run, frame, count)
+	local ok, err
+	if capture.reader then
+		ok, err = replay_frame(count)
+	else
+		ok, err = pcall(ltask.mainthread_run, frame, count)
+	end
 	if not ok then
 		print("RENDER ERR", err)
 	end
+	-- swap before waking up the batch services, they allocate from the new half once they run
+	arena.swap()
+	wakeup_update_waiting()
 	for i = 1, #batch do
 		local ptr, size, token = batch.consume(i)
 		ltask.wakeup(token)
@@ -241,29 +507,233 @@ function S.quit()
 	for addr in pairs(workers) do
 		ltask.call(addr, "quit")
 	end
+	capture_close()
 	font.shutdown()
 end
 
-function S.load_sprites(name)
-	local loader = ltask.uniqueservice "loader"
-	local spr = ltask.call(loader, "loadbundle", name)
-	local rects, from = ltask.call(loader, "pack")
+-- bytes of sprite instances uploaded in the last frame
+function S.sprite_instance_bytes()
+	return STATE.sprite_inst_bytes or 0
+end
+
+-- draw elements in the last frame, high-water mark, capacity
+function S.draw_stat()
+	return STATE.drawmgr:stat()
+end
+
+-- The sprites of each page are blitted by loader workers in bands, see loader.lua S.blit
+local function blit_pages(rects, from)
 	local imgmems = { from = from }
+	local ptrs = {}
+	local pages = {}
 	for i = 1, #rects do
 		local imgmem = image.new(setting.texture_size, setting.texture_size)
-		local canvas = imgmem:canvas()
+		local list = {}
+		local n = 0
 		for id, v in pairs(rects[i]) do
-			local src = image.canvas(v.data, v.w, v.h, v.stride)
-			image.blit(canvas, src, v.x, v.y)
+			list[n+1] = image.canvas(v.data, v.w, v.h, v.stride)
+			list[n+2] = v.x
+			list[n+3] = v.y
+			n = n + 3
 		end
 		imgmems[i] = imgmem
+		local _, _, ptr = image.canvas_size(imgmem:canvas())
+		ptrs[i] = ptr
+		-- the list refers to the images in the filecache of loader, they are alive until blitted
+		pages[i] = { ptr, image.blit_list(list) }
+	end
+	ltask.call(ltask.uniqueservice "loader", "blit", pages)
+	return imgmems, ptrs
+end
+
+-- Returns the sprite id of a new cached layer (w * h) and the handle for S.layer_update / S.layer_release
+function S.layer_new(w, h)
+	local texture_size = setting.texture_size
+	if w <= 0 or h <= 0 or w > texture_size or h > texture_size then
+		error(string.format("Invalid layer size %d * %d (texture size %d)", w, h, texture_size))
+	end
+	local texid = LAYER_TEXTUREID
+	while layers[texid] do
+		texid = texid + 1
+	end
+	-- round up to 16 pixels, instead of a full texture_size target for each layer
+	local size = (math.max(w, h) + 15) & ~15
+	if size > texture_size then
+		size = texture_size
+	end
+	-- reserve the texid before yielding, it's not drawn until it's dirty
+	local layer = { texid = texid, size = size }
+	layers[texid] = layer
+	local loader = ltask.uniqueservice "loader"
+	local ok, id = pcall(ltask.call, loader, "layer_new", w, h, texid)
+	if not ok then
+		layers[texid] = nil
+		error(id, 0)
+	end
+	layer.sprite = id
+	ltask.mainthread_run(create_layer, layer)
+	layer.dirty = true
+	STATE.sprite_dirty = true
+	return id, texid
+end
+
+-- ptr, n : the content stream from batch:transient(), redraw the layer in the next frame.
+-- An empty batch has no stream (ptr is nil), the layer is cleared.
+function S.layer_update(texid, ptr, n)
+	local layer = layers[texid]
+	if layer == nil or layer.sprite == nil or layer.release then
+		error("Invalid layer " .. texid)
+	end
+	if ptr == nil or n == 0 then
+		layer.ptr = nil
+		layer.n = nil
+	else
+		layer.ptr = ptr
+		layer.n = n
+	end
+	layer.dirty = true
+end
+
+function S.layer_release(texid)
+	local layer = layers[texid]
+	if layer == nil or layer.sprite == nil or layer.release then
+		error("Invalid layer " .. texid)
+	end
+	local loader = ltask.uniqueservice "loader"
+	ltask.call(loader, "layer_remove", layer.sprite)
+	-- render targets are released at the beginning of next frame
+	layer.release = true
+	layer.dirty = nil
+	layer.ptr = nil
+end
+
+-- Replace each page of imgmems by its mipmap chain { level0, level1, ... },
+-- the levels are generated by loader workers
+local function make_mipmaps(imgmems)
+	local levels = setting.atlas_mipmap
+	if levels == 0 then
+		return imgmems
+	end
+	trace.begin "atlas_mipmap"
+	local texture_size = setting.texture_size
+	local pages = {}
+	for i = 1, #imgmems do
+		local level0 = imgmems[i]
+		if type(level0) == "string" then
+			-- baked atlas
+			level0 = image.new(texture_size, texture_size, level0)
+		end
+		local chain = { level0 }
+		local _, _, ptr = image.canvas_size(level0:canvas())
+		local ptrs = { ptr }
+		local size = texture_size
+		for l = 1, levels do
+			size = size // 2
+			local m = image.new(size, size)
+			chain[l+1] = m
+			_, _, ptr = image.canvas_size(m:canvas())
+			ptrs[l+1] = ptr
+		end
+		imgmems[i] = chain
+		pages[i] = ptrs
+	end
+	ltask.call(ltask.uniqueservice "loader", "mipmap", pages)
+	trace.finish "atlas_mipmap"
+	return imgmems
+end
+
+-- Encode each page (or its mipmap chain) into one string of all the levels, by loader workers
+local function compress_pages(imgmems)
+	trace.begin "atlas_compress"
+	local pages = {}
+	for i = 1, #imgmems do
+		local chain = imgmems[i]
+		if type(chain) ~= "table" then
+			-- no mipmap
+			chain = { chain }
+		end
+		local ptrs = {}
+		for l = 1, #chain do
+			local _, _, ptr = image.canvas_size(chain[l]:canvas())
+			ptrs[l] = ptr
+		end
+		pages[i] = ptrs
+	end
+	local r = ltask.call(ltask.uniqueservice "loader", "compress", pages)
+	r.from = imgmems.from
+	trace.finish "atlas_compress"
+	return r
+end
+
+-- Mipmaps and block compression of new texture pages
+local function build_pages(imgmems)
+	imgmems = make_mipmaps(imgmems)
+	if STATE.compress then
+		imgmems = compress_pages(imgmems)
+	end
+	return imgmems
+end
+
+-- Loading and unloading yield in loader calls : loadbundle, pack, blit and bake share the packing state
+-- of loader (the new rects, the images in filecache and the atlas cache to bake), run them one at a time.
+local atlas_lock = util.lock()
+
+local function load_sprites(name)
+	local loader = ltask.uniqueservice "loader"
+	trace.begin "load_bundle"
+	local spr, pages = ltask.call(loader, "loadbundle", name)
+	trace.finish "load_bundle"
+	STATE.sprite_dirty = true
+	if pages then
+		-- baked atlas, compressed pages are baked with all the levels
+		if STATE.compress then
+			delay_update_image(pages)
+		else
+			delay_update_image(make_mipmaps(pages))
+		end
+		return spr
+	end
+	trace.begin "atlas_pack"
+	local rects, from = ltask.call(loader, "pack")
+	local imgmems, ptrs = blit_pages(rects, from)
+	if setting.atlas_cache and not STATE.compress then
+		ltask.call(loader, "bake", ptrs)
+	end
+	trace.finish "atlas_pack"
+	imgmems = build_pages(imgmems)
+	if setting.atlas_cache and STATE.compress then
+		ltask.call(loader, "bake", imgmems)
 	end
 	delay_update_image(imgmems)
 	return spr
 end
 
+local function unload_sprites(name)
+	local loader = ltask.uniqueservice "loader"
+	if not ltask.call(loader, "unloadbundle", name) then
+		return
+	end
+	trace.begin "atlas_compact"
+	local rects, from = ltask.call(loader, "compact")
+	local imgmems = blit_pages(rects, from)
+	trace.finish "atlas_compact"
+	delay_update_image(build_pages(imgmems), from + #rects)
+	-- the old rects are in use until the new textures are uploaded, don't pack before it
+	wait_update_image()
+end
+
+function S.load_sprites(name)
+	return atlas_lock(load_sprites, name)
+end
+
+function S.unload_sprites(name)
+	return atlas_lock(unload_sprites, name)
+end
+
 local function render_init(arg)
+	trace.begin "font_init"
 	font.init()
+	trace.finish "font_init"
 
 	local texture_size = setting.texture_size
 	local sr_buffer = render.buffer {
@@ -285,20 +755,39 @@ local function render_init(arg)
 		font = render.view { texture = font_texture },
 	}
 
+	local compress = setting.atlas_compress
+	if compress then
+		compress = string.upper(compress)
+		if compress ~= "BC3" then
+			error("Unsupported atlas_compress " .. compress)
+		end
+		if not render.pixel_format(compress) then
+			print(string.format("Pixel format %s is not supported by %s, use RGBA8", compress, render.backend()))
+			compress = nil
+		end
+	end
+
 	STATE = {
 		pass = render.pass {
 			color0 = setting.background,
 			swapchain = true,
 		},
-		default_sampler = render.sampler { label = "texquad-sampler" },
+		default_sampler = setting.atlas_mipmap > 0
+			-- trilinear for minified sprites
+			and render.sampler { label = "texquad-sampler", min_filter = "linear", mipmap_filter = "linear" }
+			or render.sampler { label = "texquad-sampler" },
 		textures = {},
+		-- pixel format of atlas textures when they are block compressed
+		compress = compress,
 		font_texture = font_texture,
 		views = views,
 	}
 	STATE.srbuffer = assert(sr_buffer)
 	STATE.srbuffer_mem = render.srbuffer(setting.srbuffer_size)
 
-	STATE.drawmgr = drawmgr.new(arg.bank_ptr, setting.draw_instance)
+	STATE.bank_ptr = arg.bank_ptr
+	STATE.drawmgr = drawmgr.new(arg.bank_ptr)
+	arena.init(setting.frame_arena_size)
 
 	STATE.uniform = render.uniform {
 		12, -- size
@@ -312,11 +801,21 @@ local function render_init(arg)
 			type = "float",
 		},
 	}
-	STATE.uniform.framesize = { 2 / arg.width, -2 / arg.height }
-	STATE.uniform.tex_size = 1 / texture_size
+	STATE.framesize = { 2 / arg.width, -2 / arg.height }
+	STATE.uniform.framesize = STATE.framesize
+	STATE.tex_size = 1 / texture_size
+	STATE.uniform.tex_size = STATE.tex_size
+	-- the origin of render targets is bottom left in GL, layers are drawn upside down there
+	local backend = render.backend()
+	if backend == "glcore" or backend == "gles3" then
+		STATE.layer_flip = 1
+	else
+		STATE.layer_flip = -1
+	end
 
 	local tmp_buffer = render.tmp_buffer(setting.tmpbuffer_size)
-	STATE.materials = create_materials {
+	trace.begin "create_materials"
+	STATE.materials, STATE.material_names = create_materials {
 		state = STATE,
 		arg = arg,
 		tmp_buffer = tmp_buffer,
@@ -324,14 +823,20 @@ local function render_init(arg)
 		font = font,
 		render = render,
 	}
+	trace.finish "create_materials"
+	capture_init()
 end
 
 function S.init(arg)
 	ltask.mainthread_run(render_init, arg)
+	if STATE.compress then
+		ltask.call(ltask.uniqueservice "loader", "texture_format", STATE.compress)
+	end
 end
 
 function S.resize(w, h)
-	STATE.uniform.framesize = { 2 / w, -2 / h }
+	STATE.framesize = { 2 / w, -2 / h }
+	STATE.uniform.framesize = STATE.framesize
 end
 
 return S
@@ -4,6 +4,7 @@ local spritemgr = require "soluna.spritemgr"
 local soluna = require "soluna"
 local soluna_app = require "soluna.app"
 local util = require "soluna.util"
+local trace = require "soluna.trace"
 local table = table
 local debug = debug
 
@@ -80,23 +81,38 @@ local function init(arg)
 		error "No command line args"
 	end
 	soluna.gamepad_init()
+	trace.begin "settings"
 	local settings = ltask.uniqueservice "settings"
 	ltask.call(settings, "init", arg)
+	trace.finish "settings"
 	
 	local setting = soluna.settings()
 	if setting.service_path then
 		ltask.servicepath(setting.service_path)
 	end
+	if setting.log_file then
+		ltask.call(ltask.uniqueservice "log", "file", setting.log_file, setting.log_rotate_size, setting.log_rotate_count)
+	end
 	
+	trace.begin "audio"
 	local audio = ltask.uniqueservice "audio"
 	ltask.call(audio, "init_device", arg.app.audio_device)
+	trace.finish "audio"
 	
+	trace.begin "loader"
 	local loader = ltask.uniqueservice "loader"
 	
 	arg.app.bank_ptr = ltask.call(loader, "init", {
 		max_sprite = setting.sprite_max,
 		texture_size = setting.texture_size,
+		compact = setting.atlas_compact,
+		mipmap = setting.atlas_mipmap,
+		premultiply = setting.atlas_premultiply,
+		worker = setting.loader_worker,
+		atlas_cache = setting.atlas_cache,
+		atlas_cache_level = setting.atlas_cache_level,
 	})
+	trace.finish "loader"
 	
 	local entry = setting.entry
 	local source = entry and file.load(entry)
@@ -108,7 +124,9 @@ local function init(arg)
 	local render = ltask.uniqueservice "render"
 	
 	local function init_render()
+		trace.begin "render_init"
 		ltask.call(render, "init", arg.app)
+		trace.finish "render_init"
 		render_service = render
 		if pre_size then
 			ltask.call(render, "resize", pre_size.width, pre_size.height)
@@ -122,12 +140,14 @@ local function init(arg)
 			batch:release()
 		end)
 		
+		trace.begin "entry"
 		local callback = f {
 			batch = batch,
 			width = arg.app.width,
 			height = arg.app.height,
 			table.unpack(arg),
 		}
+		trace.finish "entry"
 
 		if type(callback) ~= "table" then
 			app.frame = skip
@@ -136,6 +156,10 @@ local function init(arg)
 		end
 		
 		local frame_cb = callback.frame
+		if setting.frame_replay then
+			-- render service draws the captured frames, skip the game logic
+			frame_cb = skip
+		end
 	
 		local messages = { 
 			"mouse_move", "mouse_button", "mouse_scroll", "mouse", 
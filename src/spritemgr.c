@@ -2,8 +2,10 @@
 #include "sprite_submit.h"
 #include "batch.h"
 #include "transform.h"
+#include "arena.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <lua.h>
 #include <lauxlib.h>
@@ -12,17 +14,43 @@
 #define INVALID_TEXTUREID 0xffff
 
 #define MAX_NODE 8192
+#define DEFAULT_SPRITE 1024
 
 #define STB_RECT_PACK_IMPLEMENTATION
 #include "stb/stb_rect_pack.h"
 
+struct rect_storage {
+	struct rect_storage *prev;
+	struct sprite_rect rect[1];
+};
+
+static int
+bank_reserve(struct sprite_bank *b, int cap) {
+	if (cap > b->limit)
+		cap = b->limit;
+	if (cap <= b->cap)
+		return 0;
+	struct rect_storage *s = (struct rect_storage *)malloc(sizeof(*s) + (cap - 1) * sizeof(s->rect[0]));
+	if (s == NULL)
+		return 1;
+	if (b->n > 0)
+		memcpy(s->rect, b->rect, b->n * sizeof(s->rect[0]));
+	s->prev = (struct rect_storage *)b->storage;
+	b->storage = s;
+	b->rect = s->rect;
+	b->cap = cap;
+	return 0;
+}
+
 static int
 lbank_add(lua_State *L) {
 	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
-	if (b->n >= b->cap) {
-		return luaL_error(L, "Too many sprite (%d)", b->n);
+	if (b->freelist < 0 && b->n >= b->cap) {
+		if (b->n >= b->limit)
+			return luaL_error(L, "Too many sprite (%d)", b->n);
+		if (bank_reserve(b, b->cap * 2))
+			return luaL_error(L, "Too many sprite (%d) : Out of memory", b->n);
 	}
-	struct sprite_rect *r = &b->rect[b->n++];
 	int w = luaL_checkinteger(L, 2);
 	int h = luaL_checkinteger(L, 3);
 	int dx = luaL_optinteger(L, 4, 0);
@@ -31,19 +59,48 @@ lbank_add(lua_State *L) {
 		return luaL_error(L, "Invalid sprite size (%d * %d)", w, h);
 	if (dx < -0x8000 || dx > 0x7fff || dy < -0x8000 || dy > 0x7ffff)
 		return luaL_error(L, "Invalid sprite offset (%d * %d)", dx, dy);
+	int id;
+	if (b->freelist >= 0) {
+		id = b->freelist;
+		b->freelist = (int)b->rect[id].off;
+	} else {
+		id = b->n++;
+	}
+	struct sprite_rect *r = &b->rect[id];
 	r->u = w;
 	r->v = h;
 	r->off = (dx + 0x8000) << 16 | (dy + 0x8000);
 	r->texid = INVALID_TEXTUREID;
-	lua_pushinteger(L, b->n);
+	++b->live;
+	lua_pushinteger(L, id + 1);
 	return 1;
 }
 
+static int
+lbank_remove(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	int id = luaL_checkinteger(L, 2) - 1;
+	if (id < 0 || id >= b->n || b->rect[id].texid == FREE_TEXTUREID)
+		return luaL_error(L, "Invalid sprite id %d", id + 1);
+	struct sprite_rect *r = &b->rect[id];
+	r->texid = FREE_TEXTUREID;
+	r->u = 0;
+	r->v = 0;
+	r->off = (uint32_t)b->freelist;
+	b->freelist = id;
+	--b->live;
+	return 0;
+}
+
 static int
 pack_sprite(struct sprite_bank *b, stbrp_context *ctx, stbrp_node *tmp, stbrp_rect *srect, int from, int reserved, int *reserved_n) {
 	int last_texid = b->texture_n;
+	// With mipmaps, pack in blocks of (1 << mipmap) pixels, so a texel of the last level never covers two sprites
+	int shift = b->mipmap;
+	int unit = 1 << shift;
+	int size = b->texture_size >> shift;
 	
-	stbrp_init_target(ctx, b->texture_size, b->texture_size, tmp, MAX_NODE);
+	stbrp_init_target(ctx, size, size, tmp, MAX_NODE);
 	int i;
 	int rect_i = reserved;
 	for (i=from;i<b->n;i++) {
@@ -52,10 +109,10 @@ pack_sprite(struct sprite_bank *b, stbrp_context *ctx, stbrp_node *tmp, stbrp_re
 			rect->texid = last_texid;
 			stbrp_rect * sr = &srect[rect_i++];
 			sr->id = i;
-			// reserve 1 pixel border
-			sr->w = (rect->u + 1) & 0xffff;
-			sr->h = (rect->v + 1) & 0xffff;
-			if (sr->w > b->texture_size || sr->h > b->texture_size) {
+			// reserve 1 block border
+			sr->w = (((rect->u & 0xffff) + unit - 1) >> shift) + 1;
+			sr->h = (((rect->v & 0xffff) + unit - 1) >> shift) + 1;
+			if (sr->w > size || sr->h > size) {
 				return -1;
 			}
 		}
@@ -66,8 +123,8 @@ pack_sprite(struct sprite_bank *b, stbrp_context *ctx, stbrp_node *tmp, stbrp_re
 		for (j=0;j<rect_i;j++) {
 			stbrp_rect * sr = &srect[j];
 			struct sprite_rect *rect = &b->rect[sr->id];
-			rect->u = sr->x << 16 | (sr->w - 1);
-			rect->v = sr->y << 16 | (sr->h - 1);
+			rect->u = (sr->x << shift) << 16 | (rect->u & 0xffff);
+			rect->v = (sr->y << shift) << 16 | (rect->v & 0xffff);
 			rect->texid = last_texid;
 		}
 		*reserved_n = 0;
@@ -79,8 +136,8 @@ pack_sprite(struct sprite_bank *b, stbrp_context *ctx, stbrp_node *tmp, stbrp_re
 			stbrp_rect * sr = &srect[j];
 			struct sprite_rect *rect = &b->rect[sr->id];
 			if (sr->was_packed) {
-				rect->u = sr->x << 16 | (sr->w - 1);
-				rect->v = sr->y << 16 | (sr->h - 1);
+				rect->u = (sr->x << shift) << 16 | (rect->u & 0xffff);
+				rect->v = (sr->y << shift) << 16 | (rect->v & 0xffff);
 				rect->texid = last_texid;
 			} else {
 				stbrp_rect * tmp = &srect[n];
@@ -112,18 +169,19 @@ free_context(struct tmp_context *p) {
 	free(p);
 }
 
-static int
-lbank_pack(lua_State *L) {
-	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+// Returns NULL, or the error message ; it doesn't raise, so the caller can release its resources
+static const char *
+pack_rects(struct sprite_bank *b) {
 	struct tmp_context *ctx = alloc_context(b->n);
-
-	int texture = b->texture_n;
+	if (ctx == NULL)
+		return "Pack : Out of memory";
 	int from = 0;
 	int reserved = 0;
 	for (;;) {
 		from = pack_sprite(b, &ctx->ctx, ctx->tmp, ctx->rect, from, reserved, &reserved);
 		if (from < 0) {
-			return luaL_error(L, "sprite image is larger than texture");
+			free_context(ctx);
+			return "sprite image is larger than texture";
 		}
 		if (reserved == 0 && from >= b->n) {
 			break;
@@ -131,6 +189,15 @@ lbank_pack(lua_State *L) {
 		++b->texture_n;
 	}
 	free_context(ctx);
+	return NULL;
+}
+
+static int
+pack_bank(lua_State *L, struct sprite_bank *b) {
+	int texture = b->texture_n;
+	const char *err = pack_rects(b);
+	if (err)
+		return luaL_error(L, "%s", err);
 
 	lua_pushinteger(L, texture);
 	lua_pushinteger(L, b->texture_n - texture + 1);
@@ -138,14 +205,130 @@ lbank_pack(lua_State *L) {
 	return 2;
 }
 
+static int
+lbank_pack(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	if (b->pending)
+		return luaL_error(L, "Can't pack before the compaction is committed");
+	return pack_bank(L, b);
+}
+
+// Repack all the live sprites from texture 0 into a copy of the rects, the free space of removed sprites is reclaimed.
+// The rects in use are not changed until spritemgr.commit(), the textures are drawn with them until the new ones are uploaded.
+// Returns the same as pack (bank:altas() reads the copy), the textures after them have no sprites.
+static int
+lbank_compact(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	if (b->pending)
+		return luaL_error(L, "The last compaction is not committed");
+	struct sprite_rect *rect = (struct sprite_rect *)malloc((b->n + 1) * sizeof(*rect));
+	if (rect == NULL)
+		return luaL_error(L, "Compact : Out of memory");
+	memcpy(rect, b->rect, b->n * sizeof(*rect));
+	int i;
+	for (i=0;i<b->n;i++) {
+		struct sprite_rect *r = &rect[i];
+		if (r->texid < LAYER_TEXTUREID) {
+			r->texid = INVALID_TEXTUREID;
+			r->u &= 0xffff;
+			r->v &= 0xffff;
+		}
+	}
+	struct sprite_bank tmp = *b;
+	tmp.rect = rect;
+	tmp.texture_n = 0;
+	const char *err = pack_rects(&tmp);
+	if (err) {
+		free(rect);
+		return luaL_error(L, "%s", err);
+	}
+	b->pending = rect;
+	b->pending_n = b->n;
+	b->pending_texture_n = tmp.texture_n;
+	lua_pushinteger(L, 0);
+	lua_pushinteger(L, tmp.texture_n + 1);
+	return 2;
+}
+
+// commit(bank_ptr) : replace the rects by the ones from bank:compact(), render service calls it with the new textures.
+// The sprites added to or removed from the bank since the compaction (cached layers) are kept.
+static int
+lsprite_commit(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TLIGHTUSERDATA);
+	struct sprite_bank *b = (struct sprite_bank *)lua_touserdata(L, 1);
+	struct sprite_rect *pending = b->pending;
+	if (pending == NULL) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+	int i;
+	for (i=0;i<b->pending_n;i++) {
+		struct sprite_rect *r = &b->rect[i];
+		if (r->texid < LAYER_TEXTUREID && pending[i].texid < LAYER_TEXTUREID) {
+			*r = pending[i];
+		}
+	}
+	b->texture_n = b->pending_texture_n;
+	b->pending = NULL;
+	free(pending);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+// Returns an array of the pixels used by live sprites in each texture
+static int
+lbank_pages(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	int n = b->texture_n + 1;
+	lua_createtable(L, n, 0);
+	int i;
+	for (i=1;i<=n;i++) {
+		lua_pushinteger(L, 0);
+		lua_rawseti(L, -2, i);
+	}
+	for (i=0;i<b->n;i++) {
+		struct sprite_rect *rect = &b->rect[i];
+		if (rect->texid < n) {
+			int idx = rect->texid + 1;
+			lua_Integer area = (lua_Integer)((rect->u & 0xffff) + 1) * ((rect->v & 0xffff) + 1);
+			lua_rawgeti(L, -1, idx);
+			area += lua_tointeger(L, -1);
+			lua_pop(L, 1);
+			lua_pushinteger(L, area);
+			lua_rawseti(L, -2, idx);
+		}
+	}
+	return 1;
+}
+
+// Bind a sprite to the texture of a cached layer, the sprite is the top left (w, h) of the texture
+static int
+lbank_layer(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	int id = luaL_checkinteger(L, 2) - 1;
+	int texid = luaL_checkinteger(L, 3);
+	if (id < 0 || id >= b->n || b->rect[id].texid != INVALID_TEXTUREID)
+		return luaL_error(L, "Invalid sprite id %d", id + 1);
+	if (texid < LAYER_TEXTUREID || texid >= FREE_TEXTUREID)
+		return luaL_error(L, "Invalid layer texture id %d", texid);
+	struct sprite_rect *r = &b->rect[id];
+	r->u &= 0xffff;
+	r->v &= 0xffff;
+	r->texid = texid;
+	return 0;
+}
+
 static int
 lbank_altas(lua_State *L) {
 	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
 	int tid = luaL_checkinteger(L, 2);
+	// the rects repacked by compact, before commit
+	struct sprite_rect *rects = b->pending ? b->pending : b->rect;
+	int n = b->pending ? b->pending_n : b->n;
 	int i;
 	lua_newtable(L);
-	for (i=0;i<b->n;i++) {
-		struct sprite_rect *rect = &b->rect[i];
+	for (i=0;i<n;i++) {
+		struct sprite_rect *rect = &rects[i];
 		if (rect->texid == tid) {
 			uint64_t x = rect->u >> 16;
 			uint64_t y = rect->v >> 16;
@@ -164,23 +347,98 @@ lbank_ptr(lua_State *L) {
 	return 1;
 }
 
+static int
+lbank_dump(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	lua_pushlstring(L, (const char *)b->rect, b->n * sizeof(b->rect[0]));
+	lua_pushinteger(L, b->texture_n);
+	return 2;
+}
+
+// restore rects from bank:dump() after the same sprites are added again
+static int
+lbank_restore(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	size_t sz;
+	const char *rects = luaL_checklstring(L, 2, &sz);
+	int texture_n = luaL_checkinteger(L, 3);
+	if (sz != b->n * sizeof(b->rect[0]))
+		return luaL_error(L, "Invalid rects size %d (%d sprites)", (int)sz, b->n);
+	if (b->live != b->n)
+		return luaL_error(L, "Can't restore rects after remove");
+	memcpy(b->rect, rects, sz);
+	b->texture_n = texture_n;
+	return 0;
+}
+
+static int
+lbank_stat(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)luaL_checkudata(L, 1, "SOLUNA_SPRITEBANK");
+	lua_pushinteger(L, b->n);
+	lua_pushinteger(L, b->cap);
+	lua_pushinteger(L, b->limit);
+	lua_pushinteger(L, b->live);
+	return 4;
+}
+
+static int
+lbank_gc(lua_State *L) {
+	struct sprite_bank *b = (struct sprite_bank *)lua_touserdata(L, 1);
+	struct rect_storage *s = (struct rect_storage *)b->storage;
+	while (s) {
+		struct rect_storage *prev = s->prev;
+		free(s);
+		s = prev;
+	}
+	b->storage = NULL;
+	b->rect = NULL;
+	b->n = 0;
+	b->cap = 0;
+	free(b->pending);
+	b->pending = NULL;
+	return 0;
+}
+
+// limit : max number of sprites, the rects grow from a small array when sprites are added
 static int
 lsprite_newbank(lua_State *L) {
-	int cap = luaL_checkinteger(L, 1);
+	int limit = luaL_checkinteger(L, 1);
 	int texture_size = luaL_optinteger(L, 2, DEFAULT_TEXTURE_SIZE);
-	struct sprite_bank *b = (struct sprite_bank *)lua_newuserdatauv(L, sizeof(*b) + (cap-1) * sizeof(b->rect[0]), 0);
+	int mipmap = luaL_optinteger(L, 3, 0);
+	if (limit <= 0)
+		return luaL_error(L, "Invalid sprite limit %d", limit);
+	if (mipmap < 0 || (texture_size >> mipmap) < 1)
+		return luaL_error(L, "Invalid mipmap levels %d", mipmap);
+	struct sprite_bank *b = (struct sprite_bank *)lua_newuserdatauv(L, sizeof(*b), 0);
 	b->n = 0;
-	b->cap = cap;
+	b->cap = 0;
+	b->limit = limit;
+	b->live = 0;
+	b->freelist = -1;
 	b->texture_size = texture_size;
 	b->texture_n = 0;
+	b->mipmap = mipmap;
+	b->rect = NULL;
+	b->storage = NULL;
+	b->pending = NULL;
+	b->pending_n = 0;
+	b->pending_texture_n = 0;
 	
 	if (luaL_newmetatable(L, "SOLUNA_SPRITEBANK")) {
 		luaL_Reg l[] = {
 			{ "__index", NULL },
+			{ "__gc", lbank_gc },
+			{ "stat", lbank_stat },
 			{ "add", lbank_add },
+			{ "remove", lbank_remove },
 			{ "pack", lbank_pack },
+			{ "compact", lbank_compact },
+			{ "pages", lbank_pages },
+			{ "layer", lbank_layer },
 			{ "altas", lbank_altas },
 			{ "ptr", lbank_ptr },
+			{ "dump", lbank_dump },
+			{ "restore", lbank_restore },
 			{ NULL, NULL },
 		};
 		luaL_setfuncs(L, l, 0);
@@ -189,6 +447,8 @@ lsprite_newbank(lua_State *L) {
 		lua_setfield(L, -2, "__index");
 	}
 	lua_setmetatable(L, -2);
+	if (bank_reserve(b, DEFAULT_SPRITE))
+		return luaL_error(L, "Sprite bank : Out of memory");
 	
 	return 1;
 }
@@ -335,6 +595,22 @@ lbatch_add(lua_State *L) {
 	return 0;
 }
 
+// Copy the stream into the frame arena, it's valid until the end of next frame
+static int
+lbatch_transient(lua_State *L) {
+	struct batch *b = (struct batch *)luaL_checkudata(L, 1, "SOLUNA_BATCH");
+	if (b->n == 0)
+		return 0;
+	size_t sz = b->n * sizeof(struct draw_primitive);
+	void *ptr = frame_arena_alloc(sz);
+	if (ptr == NULL)
+		return luaL_error(L, "Frame arena : Out of memory");
+	memcpy(ptr, batch_reserve(b->b, 0), sz);
+	lua_pushlightuserdata(L, ptr);
+	lua_pushinteger(L, b->n);
+	return 2;
+}
+
 static int
 lbatch_ptr(lua_State *L) {
 	struct batch *b = (struct batch *)luaL_checkudata(L, 1, "SOLUNA_BATCH");
@@ -489,6 +765,7 @@ lsprite_newbatch(lua_State *L) {
 			{ "reset", lbatch_reset },
 			{ "add", lbatch_add },
 			{ "ptr", lbatch_ptr },
+			{ "transient", lbatch_transient },
 			{ "release", lbatch_release },
 			{ "layer", lbatch_layer },
 			{ "point", lbatch_point },
@@ -510,6 +787,7 @@ luaopen_spritemgr(lua_State *L) {
 	luaL_Reg l[] = {
 		{ "newbank", lsprite_newbank },
 		{ "newbatch", lsprite_newbatch },
+		{ "commit", lsprite_commit },
 		{ NULL, NULL },
 	};
 	luaL_newlib(L, l);
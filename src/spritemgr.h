@@ -5,6 +5,9 @@
 #include <assert.h>
 
 #define INVALID_TEXTUREID 0xffff
+#define FREE_TEXTUREID 0xfffe
+// textures of cached layers are [LAYER_TEXTUREID, FREE_TEXTUREID), they are not atlas pages
+#define LAYER_TEXTUREID 0x8000
 
 struct sprite_rect {
 	uint32_t texid;
@@ -13,12 +16,24 @@ struct sprite_rect {
 	uint32_t v;		// y << 16 | h
 };
 
+// rect grows with n up to limit. The old arrays are kept until the bank is collected,
+// so a pointer read by the render service stays valid while the loader adds sprites.
+// Removed rects are linked by .off from freelist (texid is FREE_TEXTUREID), and reused by add.
 struct sprite_bank {
 	int n;
 	int cap;
+	int limit;
+	int live;
+	int freelist;
 	int texture_size;
 	int texture_n;
-	struct sprite_rect rect[1];
+	int mipmap;	// extra mipmap levels of textures, sprites are aligned to (1 << mipmap)
+	struct sprite_rect *rect;
+	void *storage;
+	// rects repacked by bank:compact(), they replace rect when the new textures are uploaded (spritemgr.commit)
+	struct sprite_rect *pending;
+	int pending_n;
+	int pending_texture_n;
 };
 
 #endif
@@ -0,0 +1,16 @@
+@block sr_decode
+// draw_primitive.sr : 20 bits scale, 12 bits rotation, see srbuffer_add()
+mat2 sr_decode(uint v) {
+	uint scale_fix = v >> 12;
+	float scale = 1.0f;
+	if (scale_fix >= 0xff000u) {
+		scale = float(scale_fix & 0xfffu) / 4096.0f;
+	} else if (scale_fix != 0u) {
+		scale = float(scale_fix) / 256.0f + 1.0f;
+	}
+	float rot = float(v & 0xfffu) * (3.1415927f / 2048.0f);
+	float c = cos(rot) * scale;
+	float s = sin(rot) * scale;
+	return mat2(c, -s, s, c);
+}
+@end
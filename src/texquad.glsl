@@ -1,3 +1,5 @@
+@include srdecode.glsl
+
 @vs vs
 layout(binding=0) uniform vs_params {
 	vec2 framesize;
@@ -26,12 +28,118 @@ void main() {
 	ivec2 off = ivec2(offset >> 16 , offset & 0xffff) - 0x8000;
 	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
 	vec2 pos = ((uv_offset - off) * sr[int(position.z)].m + position.xy) * framesize;
-	gl_Position = vec4(pos.x - 1.0f, pos.y + 1.0f, 0, 1);
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
 	uv = (uv_base + uv_offset) * texsize;
 }
 
 @end
 
+// sr is decoded in vertex shader, no sr buffer
+@vs vs_direct
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+	float texsize;
+};
+
+@include_block sr_decode
+
+in vec2 position;
+in uint sr;
+in uint offset;
+in uint u;
+in uint v;
+
+out vec2 uv;
+
+void main() {
+	ivec2 uv_base = ivec2(u >> 16, v >> 16);
+	ivec2 u2 = ivec2(0 , u & 0xffff);
+	ivec2 v2 = ivec2(0 , v & 0xffff);
+	ivec2 off = ivec2(offset >> 16 , offset & 0xffff) - 0x8000;
+	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
+	vec2 pos = ((uv_offset - off) * sr_decode(sr) + position.xy) * framesize;
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
+	uv = (uv_base + uv_offset) * texsize;
+}
+
+@end
+
+// compact instance : 24.8 fix position, sr and the index of sprite rect (16 bytes)
+@block compact_vertex
+struct sprite_rect {
+	uint texid;
+	uint off;
+	uint u;
+	uint v;
+};
+
+layout(binding=2) readonly buffer rect_lut {
+	sprite_rect rect[];
+};
+
+void compact_vertex(mat2 m) {
+	sprite_rect r = rect[sprite];
+	ivec2 uv_base = ivec2(r.u >> 16, r.v >> 16);
+	ivec2 u2 = ivec2(0 , r.u & 0xffff);
+	ivec2 v2 = ivec2(0 , r.v & 0xffff);
+	ivec2 off = ivec2(r.off >> 16 , r.off & 0xffff) - 0x8000;
+	vec2 uv_offset = vec2(u2[gl_VertexIndex & 1] , v2[gl_VertexIndex >> 1]);
+	vec2 pos = ((uv_offset - off) * m + vec2(position) / 256.0f) * framesize;
+	gl_Position = vec4(pos.x - 1.0f, pos.y - sign(framesize.y), 0, 1);
+	uv = (uv_base + uv_offset) * texsize;
+}
+@end
+
+@vs vs_compact
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+	float texsize;
+};
+
+struct sr_mat {
+	mat2 m;
+};
+
+layout(binding=0) readonly buffer sr_lut {
+	sr_mat sr[];
+};
+
+in ivec2 position;
+in uint sr_index;
+in uint sprite;
+
+out vec2 uv;
+
+@include_block compact_vertex
+
+void main() {
+	compact_vertex(sr[sr_index].m);
+}
+
+@end
+
+@vs vs_compact_direct
+layout(binding=0) uniform vs_params {
+	vec2 framesize;
+	float texsize;
+};
+
+@include_block sr_decode
+
+in ivec2 position;
+in uint sr;
+in uint sprite;
+
+out vec2 uv;
+
+@include_block compact_vertex
+
+void main() {
+	compact_vertex(sr_decode(sr));
+}
+
+@end
+
 @fs fs
 layout(binding=1) uniform texture2D tex;
 layout(binding=0) uniform sampler smp;
@@ -44,4 +152,7 @@ void main() {
 }
 @end
 
-@program texquad vs fs
\ No newline at end of file
+@program texquad vs fs
+@program texquad_direct vs_direct fs
+@program texquad_compact vs_compact fs
+@program texquad_compact_direct vs_compact_direct fs
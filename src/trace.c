@@ -0,0 +1,290 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "trace.h"
+
+#define TRACE_MAX_EVENT 4096
+#define TRACE_MAX_THREAD 256
+#define TRACE_NAME 48
+#define TRACE_TID "SOLUNA_TRACE_TID"
+
+struct trace_event {
+	double ts;	// microseconds
+	int tid;
+	const void *co;	// coroutine of the lua VM, NULL for the main thread (or C)
+	char phase;
+	char name[TRACE_NAME];
+};
+
+// Events are appended by any thread (C main thread, and lua services), extra events are dropped.
+// An event is visible after its ready flag is set.
+static struct {
+	atomic_int n;
+	atomic_int tid;
+	double origin;
+	atomic_int ready[TRACE_MAX_EVENT];
+	struct trace_event e[TRACE_MAX_EVENT];
+	char thread[TRACE_MAX_THREAD][TRACE_NAME];
+} TRACE;
+
+static double
+monotonic_us(void) {
+#if defined(_WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER c;
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&c);
+	return (double)c.QuadPart * 1000000.0 / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+#endif
+}
+
+static double
+trace_now(void) {
+	// sokol_main traces the first event from the main thread before any service starts
+	if (TRACE.origin == 0)
+		TRACE.origin = monotonic_us();
+	return monotonic_us() - TRACE.origin;
+}
+
+static void
+trace_event(const char *name, size_t sz, char phase, int tid, const void *co) {
+	double ts = trace_now();
+	int idx = atomic_fetch_add_explicit(&TRACE.n, 1, memory_order_relaxed);
+	if (idx >= TRACE_MAX_EVENT)
+		return;
+	struct trace_event *e = &TRACE.e[idx];
+	e->ts = ts;
+	e->tid = tid;
+	e->co = co;
+	e->phase = phase;
+	if (sz >= TRACE_NAME)
+		sz = TRACE_NAME - 1;
+	memcpy(e->name, name, sz);
+	e->name[sz] = 0;
+	atomic_store_explicit(&TRACE.ready[idx], 1, memory_order_release);
+}
+
+void
+soluna_trace(const char *name, char phase, int tid) {
+	trace_event(name, strlen(name), phase, tid, NULL);
+}
+
+double
+soluna_trace_time(void) {
+	return trace_now() / 1000.0;
+}
+
+static int
+event_count(void) {
+	int n = atomic_load_explicit(&TRACE.n, memory_order_relaxed);
+	if (n > TRACE_MAX_EVENT)
+		n = TRACE_MAX_EVENT;
+	return n;
+}
+
+static const char *
+thread_name(int tid) {
+	if (tid == 0)
+		return "main";
+	if (tid < TRACE_MAX_THREAD && TRACE.thread[tid][0])
+		return TRACE.thread[tid];
+	return "?";
+}
+
+static void
+write_string(FILE *f, const char *s) {
+	fputc('"', f);
+	for (;*s;s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 32)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+int
+soluna_trace_write(const char *filename) {
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL)
+		return 1;
+	int n = event_count();
+	int tid_n = atomic_load_explicit(&TRACE.tid, memory_order_relaxed) + 1;
+	if (tid_n > TRACE_MAX_THREAD)
+		tid_n = TRACE_MAX_THREAD;
+	fprintf(f, "{\"traceEvents\":[\n");
+	int i;
+	for (i=0;i<tid_n;i++) {
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", i);
+		write_string(f, thread_name(i));
+		fprintf(f, "}},\n");
+	}
+	for (i=0;i<n;i++) {
+		if (!atomic_load_explicit(&TRACE.ready[i], memory_order_acquire))
+			continue;
+		struct trace_event *e = &TRACE.e[i];
+		fprintf(f, "{\"name\":");
+		write_string(f, e->name);
+		if (e->co && e->phase != 'i') {
+			// phases in coroutines may interleave in one thread, write them as async events of the coroutine
+			fprintf(f, ",\"ph\":\"%c\",\"cat\":\"coroutine\",\"id\":\"%p\",\"ts\":%.3f,\"pid\":1,\"tid\":%d},\n", e->phase == 'B' ? 'b' : 'e', e->co, e->ts, e->tid);
+		} else {
+			fprintf(f, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s},\n", e->phase, e->ts, e->tid, e->phase == 'i' ? ",\"s\":\"g\"" : "");
+		}
+	}
+	fprintf(f, "{}]}\n");
+	fclose(f);
+	return 0;
+}
+
+// Each lua VM (an ltask service) gets its own tid
+static int
+get_tid(lua_State *L) {
+	int tid;
+	if (lua_getfield(L, LUA_REGISTRYINDEX, TRACE_TID) == LUA_TNUMBER) {
+		tid = lua_tointeger(L, -1);
+	} else {
+		tid = atomic_fetch_add_explicit(&TRACE.tid, 1, memory_order_relaxed) + 1;
+		lua_pushinteger(L, tid);
+		lua_setfield(L, LUA_REGISTRYINDEX, TRACE_TID);
+	}
+	lua_pop(L, 1);
+	return tid;
+}
+
+// Coroutines of a VM (ltask sessions) interleave, so begin and finish are paired in the same coroutine
+static const void *
+get_co(lua_State *L) {
+	int main = lua_pushthread(L);
+	lua_pop(L, 1);
+	return main ? NULL : (const void *)L;
+}
+
+static int
+ltrace(lua_State *L, char phase) {
+	size_t sz;
+	const char *name = luaL_checklstring(L, 1, &sz);
+	trace_event(name, sz, phase, get_tid(L), get_co(L));
+	return 0;
+}
+
+static int
+ltrace_begin(lua_State *L) {
+	return ltrace(L, 'B');
+}
+
+static int
+ltrace_finish(lua_State *L) {
+	return ltrace(L, 'E');
+}
+
+static int
+ltrace_mark(lua_State *L) {
+	return ltrace(L, 'i');
+}
+
+static int
+ltrace_name(lua_State *L) {
+	size_t sz;
+	const char *name = luaL_checklstring(L, 1, &sz);
+	int tid = get_tid(L);
+	if (tid < TRACE_MAX_THREAD) {
+		if (sz >= TRACE_NAME)
+			sz = TRACE_NAME - 1;
+		memcpy(TRACE.thread[tid], name, sz);
+		TRACE.thread[tid][sz] = 0;
+	}
+	return 0;
+}
+
+static double
+duration(int index) {
+	const struct trace_event *e = &TRACE.e[index];
+	int depth = 0;
+	int i;
+	for (i=index-1;i>=0;i--) {
+		const struct trace_event *b = &TRACE.e[i];
+		if (b->tid != e->tid || b->co != e->co || !atomic_load_explicit(&TRACE.ready[i], memory_order_acquire))
+			continue;
+		if (b->phase == 'E') {
+			++depth;
+		} else if (b->phase == 'B') {
+			if (depth == 0)
+				return e->ts - b->ts;
+			--depth;
+		}
+	}
+	return -1;
+}
+
+// Text report, one line per event ; 'E' lines have the duration of the phase
+static int
+ltrace_report(lua_State *L) {
+	luaL_Buffer b;
+	luaL_buffinit(L, &b);
+	int n = event_count();
+	int i;
+	for (i=0;i<n;i++) {
+		if (!atomic_load_explicit(&TRACE.ready[i], memory_order_acquire))
+			continue;
+		const struct trace_event *e = &TRACE.e[i];
+		char line[256];
+		if (e->phase == 'E') {
+			snprintf(line, sizeof(line), "%10.3f ms %-12s end   %s (%.3f ms)\n", e->ts / 1000.0, thread_name(e->tid), e->name, duration(i) / 1000.0);
+		} else {
+			snprintf(line, sizeof(line), "%10.3f ms %-12s %s %s\n", e->ts / 1000.0, thread_name(e->tid), e->phase == 'B' ? "begin" : "mark ", e->name);
+		}
+		luaL_addstring(&b, line);
+	}
+	if (atomic_load_explicit(&TRACE.n, memory_order_relaxed) > TRACE_MAX_EVENT) {
+		luaL_addstring(&b, "(trace events dropped)\n");
+	}
+	luaL_pushresult(&b);
+	return 1;
+}
+
+static int
+ltrace_write(lua_State *L) {
+	const char *filename = luaL_checkstring(L, 1);
+	if (soluna_trace_write(filename))
+		return luaL_error(L, "Can't write trace to %s", filename);
+	return 0;
+}
+
+int
+luaopen_soluna_trace(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "begin", ltrace_begin },
+		{ "finish", ltrace_finish },
+		{ "mark", ltrace_mark },
+		{ "name", ltrace_name },
+		{ "report", ltrace_report },
+		{ "write", ltrace_write },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
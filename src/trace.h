@@ -0,0 +1,12 @@
+#ifndef soluna_trace_h
+#define soluna_trace_h
+
+// Startup timeline, see trace.c
+// phase : 'B' begin, 'E' end, 'i' instant ; tid 0 is the main thread
+void soluna_trace(const char *name, char phase, int tid);
+// milliseconds since the first event
+double soluna_trace_time(void);
+// write events in chrome trace json format, returns 0 when succeed
+int soluna_trace_write(const char *filename);
+
+#endif
@@ -3,19 +3,119 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <string.h>
 #include <ctype.h>
 #include "loginfo.h"
 
+#define LOG_INFO_POOL 256
+#define DEFAULT_BUFFER 0x10000
+#define DEFAULT_ROTATE_COUNT 4
+
+// sokol log records, allocated by any thread (log_func in entry.c), and freed by log service.
+// Messages are dropped when all the records are in flight.
+static struct {
+	atomic_uint cursor;
+	atomic_int dropped;
+	atomic_int used[LOG_INFO_POOL];
+	struct log_info slot[LOG_INFO_POOL];
+} LOGPOOL;
+
+struct log_info *
+log_info_alloc(void) {
+	unsigned start = atomic_fetch_add_explicit(&LOGPOOL.cursor, 1, memory_order_relaxed);
+	int i;
+	for (i=0;i<LOG_INFO_POOL;i++) {
+		int idx = (start + i) % LOG_INFO_POOL;
+		if (atomic_exchange_explicit(&LOGPOOL.used[idx], 1, memory_order_acquire) == 0)
+			return &LOGPOOL.slot[idx];
+	}
+	atomic_fetch_add_explicit(&LOGPOOL.dropped, 1, memory_order_relaxed);
+	return NULL;
+}
+
+void
+log_info_free(struct log_info *info) {
+	atomic_store_explicit(&LOGPOOL.used[info - LOGPOOL.slot], 0, memory_order_release);
+}
+
+// Only the log service uses the buffer below :
+// logs are formatted into one buffer, and written by a single fwrite in writelog.flush()
+struct log_buffer {
+	char *ptr;
+	size_t n;
+	size_t cap;
+	time_t sec;
+	char stamp[24];
+	FILE *file;
+	char *filename;
+	long file_size;
+	long rotate_size;
+	int rotate_count;
+};
+
+static struct log_buffer LOGBUF;
+
+static char *
+buffer_reserve(size_t sz) {
+	struct log_buffer *B = &LOGBUF;
+	if (B->n + sz > B->cap) {
+		size_t cap = B->cap ? B->cap : DEFAULT_BUFFER;
+		while (cap < B->n + sz)
+			cap *= 2;
+		char *ptr = (char *)realloc(B->ptr, cap);
+		if (ptr == NULL)
+			return NULL;
+		B->ptr = ptr;
+		B->cap = cap;
+	}
+	return B->ptr + B->n;
+}
+
+static void
+buffer_printf(const char *fmt, ...) {
+	struct log_buffer *B = &LOGBUF;
+	size_t sz = 256;
+	for (;;) {
+		char *ptr = buffer_reserve(sz);
+		if (ptr == NULL)
+			return;
+		va_list ap;
+		va_start(ap, fmt);
+		int n = vsnprintf(ptr, sz, fmt, ap);
+		va_end(ap);
+		if (n < 0)
+			return;
+		if ((size_t)n < sz) {
+			B->n += n;
+			return;
+		}
+		sz = n + 1;
+	}
+}
+
+static inline void
+buffer_char(char c) {
+	char *ptr = buffer_reserve(1);
+	if (ptr) {
+		*ptr = c;
+		++LOGBUF.n;
+	}
+}
+
 static void
 write_timestamp(uint64_t ti) {
+	struct log_buffer *B = &LOGBUF;
 	time_t timer = ti / 100;
 	int msec = ti % 100;
-	char buffer[26];
-	struct tm* tm_info = localtime(&timer);
-    strftime(buffer, 26, "%Y-%m-%d %H:%M:%S", tm_info);	
-	printf("[%s.%02d]", buffer, msec);
+	if (timer != B->sec || B->stamp[0] == 0) {
+		struct tm* tm_info = localtime(&timer);
+		strftime(B->stamp, sizeof(B->stamp), "%Y-%m-%d %H:%M:%S", tm_info);
+		B->sec = timer;
+	}
+	buffer_printf("[%s.%02d]", B->stamp, msec);
 }
 
 static int
@@ -31,12 +131,12 @@ log_write_sokol(lua_State *L) {
 	if (info->log_level > 3)
 		info->log_level = 3;
 	write_timestamp(ti);
-	printf("[%-5s]( %s:%d )", level[info->log_level], info->tag, info->log_item );
+	buffer_printf("[%-5s]( %s:%d )", level[info->log_level], info->tag, info->log_item );
 	if (info->filename) {
-		printf(" %s : (%d)", info->filename, info->line_nr);
+		buffer_printf(" %s : (%d)", info->filename, info->line_nr);
 	}
-	printf(" %s\n", info->message);
-	free(info);
+	buffer_printf(" %s\n", info->message);
+	log_info_free(info);
 	return 0;
 }
 
@@ -48,28 +148,121 @@ log_write_ltask(lua_State *L) {
 	const char *msg = luaL_checklstring(L, 3, &sz);
 	char upper[6];
 	int i;
-	for (i=0;i<5;i++) {
+	for (i=0;i<5 && level[i];i++) {
 		upper[i] = toupper(level[i]);
-		if (*level == 0)
-			break;
 	}
-	upper[5] = 0;
+	upper[i] = 0;
 	write_timestamp(ti);
+	buffer_printf("[%-5s]", upper);
+	char *ptr = buffer_reserve(sz * 3 + 2);
+	if (ptr == NULL)
+		return 0;
 	if (strnlen(msg, sz+1) < sz) {
-		printf("[%-5s] ", upper);
-		int i;
+		buffer_char(' ');
 		for (i=0;i<sz;i++) {
 			unsigned char c = (unsigned char)msg[i];
 			if (c < 32) {
-				printf("/%02X", c);
+				buffer_printf("/%02X", c);
 			} else {
-				printf("%c", c);
+				buffer_char(c);
 			}
 		}
-		printf("\n");
 	} else {
-		printf("[%-5s]%s\n", upper, msg );
+		memcpy(ptr, msg, sz);
+		LOGBUF.n += sz;
 	}
+	buffer_char('\n');
+	return 0;
+}
+
+static void
+rotate_name(char *buf, size_t sz, const char *filename, int idx) {
+	if (idx == 0)
+		snprintf(buf, sz, "%s", filename);
+	else
+		snprintf(buf, sz, "%s.%d", filename, idx);
+}
+
+// filename -> filename.1 -> ... -> filename.(rotate_count)
+static void
+rotate_file(struct log_buffer *B) {
+	fclose(B->file);
+	B->file = NULL;
+	size_t sz = strlen(B->filename) + 16;
+	char *from = (char *)malloc(sz);
+	char *to = (char *)malloc(sz);
+	if (from && to) {
+		int i;
+		rotate_name(to, sz, B->filename, B->rotate_count);
+		remove(to);
+		for (i=B->rotate_count-1;i>=0;i--) {
+			rotate_name(from, sz, B->filename, i);
+			rotate_name(to, sz, B->filename, i+1);
+			rename(from, to);
+		}
+	}
+	free(from);
+	free(to);
+	B->file = fopen(B->filename, "wb");
+	B->file_size = 0;
+}
+
+static int
+log_flush(lua_State *L) {
+	struct log_buffer *B = &LOGBUF;
+	int dropped = atomic_exchange_explicit(&LOGPOOL.dropped, 0, memory_order_relaxed);
+	if (dropped) {
+		buffer_printf("[%s.00][WARN ] %d log messages dropped\n", B->stamp, dropped);
+	}
+	if (B->n == 0)
+		return 0;
+	fwrite(B->ptr, 1, B->n, stdout);
+	fflush(stdout);
+	if (B->file) {
+		fwrite(B->ptr, 1, B->n, B->file);
+		fflush(B->file);
+		B->file_size += B->n;
+		if (B->rotate_size > 0 && B->file_size >= B->rotate_size)
+			rotate_file(B);
+	}
+	B->n = 0;
+	return 0;
+}
+
+static void
+close_file(struct log_buffer *B) {
+	if (B->file) {
+		fclose(B->file);
+		B->file = NULL;
+	}
+	free(B->filename);
+	B->filename = NULL;
+}
+
+static int
+log_file(lua_State *L) {
+	struct log_buffer *B = &LOGBUF;
+	close_file(B);
+	if (lua_isnoneornil(L, 1))
+		return 0;
+	size_t sz;
+	const char *filename = luaL_checklstring(L, 1, &sz);
+	long rotate_size = (long)luaL_optinteger(L, 2, 0);
+	int rotate_count = luaL_optinteger(L, 3, DEFAULT_ROTATE_COUNT);
+	FILE *f = fopen(filename, "ab");
+	if (f == NULL)
+		return luaL_error(L, "Can't open log file %s", filename);
+	B->filename = (char *)malloc(sz + 1);
+	if (B->filename == NULL) {
+		fclose(f);
+		return luaL_error(L, "Log file OOM");
+	}
+	memcpy(B->filename, filename, sz + 1);
+	fseek(f, 0, SEEK_END);
+	B->file = f;
+	B->file_size = ftell(f);
+	B->rotate_size = rotate_size;
+	B->rotate_count = rotate_count > 0 ? rotate_count : 1;
 	return 0;
 }
 
@@ -79,9 +272,10 @@ luaopen_applog(lua_State *L) {
 	luaL_Reg l[] = {
 		{ "sokol", log_write_sokol },
 		{ "ltask", log_write_ltask },
+		{ "flush", log_flush },
+		{ "file", log_file },
 		{ NULL, NULL },
 	};
 	luaL_newlib(L, l);
 	return 1;
 }
-
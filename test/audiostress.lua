@@ -0,0 +1,58 @@
+local soluna = require "soluna"
+local ltask = require "ltask"
+
+-- Play 1000 overlapping short sounds in bursts, and print the time spent in play_sound.
+-- The first burst decodes nothing (samples are decoded in load_sounds), later bursts reuse pooled voices.
+
+soluna.load_sounds "asset/sounds.dl"
+soluna.set_window_title "soluna audio stress"
+
+local SOUNDS <const> = 1000
+local BURST <const> = 100
+local INTERVAL <const> = 200	-- centiseconds between two rounds
+
+local callback = {}
+
+local voices = {}
+local played = 0
+local round = 0
+local round_start
+local play_time = 0
+
+function callback.frame()
+	local _, now = ltask.now()
+	if played == 0 and round_start and now - round_start < INTERVAL then
+		return
+	end
+	if played == 0 then
+		round_start = now
+		round = round + 1
+	end
+	local t0 = ltask.counter()
+	for i = 1, BURST do
+		local voice = assert(soluna.play_sound("bloop", {
+			volume = 1 / SOUNDS,
+			pan = (played % 21 - 10) / 10,
+			pitch = 0.5 + played % 50 / 50,
+		}))
+		played = played + 1
+		voices[played] = voice
+	end
+	play_time = play_time + ltask.counter() - t0
+	if played >= SOUNDS then
+		local playing = soluna.voice_query(voices)
+		local n = 0
+		for i = 1, #playing do
+			if playing[i] then
+				n = n + 1
+			end
+		end
+		print(string.format("round %d : %d sounds, %.3f ms per play_sound, %d still playing",
+			round, played, play_time * 1000 / played, n))
+		played = 0
+		play_time = 0
+		voices = {}
+	end
+end
+
+return callback
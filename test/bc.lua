@@ -0,0 +1,43 @@
+local image = require "soluna.image"
+local bc = require "soluna.image.bc"
+local file = require "soluna.file"
+
+-- BC3 encoder quality and throughput, CPU only
+
+local function test(name, content, w, h)
+	local t = os.clock()
+	local blocks = bc.encode(content, w, h)
+	local encode_time = os.clock() - t
+	assert(#blocks == bc.size(w, h))
+	local decoded = bc.decode(blocks, w, h)
+	local psnr = bc.psnr(content, decoded, w, h)
+	print(string.format("%-10s %4d * %4d : PSNR %.2f dB, %.3f ms, %.2f Mpixel/s",
+		name, w, h, psnr, encode_time * 1000, w * h / encode_time / 1e6))
+	return psnr
+end
+
+local content, w, h = image.load(file.load "asset/avatar.png")
+assert(test("avatar", content, w, h) > 30)
+
+local function gradient(size)
+	local p = {}
+	for y = 0, size - 1 do
+		for x = 0, size - 1 do
+			p[#p+1] = string.pack("BBBB", x * 255 // (size - 1), y * 255 // (size - 1), (x + y) * 255 // (size * 2 - 2), 255 - x * 255 // (size - 1))
+		end
+	end
+	return table.concat(p)
+end
+
+assert(test("gradient", gradient(256), 256, 256) > 30)
+
+-- sizes not multiple of 4
+local odd = gradient(37)
+test("odd", odd, 37, 37)
+
+local solid = string.pack("BBBB", 12, 34, 56, 78):rep(16 * 16)
+assert(test("solid", solid, 16, 16) > 38)
+
+local page = 1024
+local big = gradient(page)
+test("page", big, page, page)
@@ -0,0 +1,71 @@
+local image = require "soluna.image"
+local bc = require "soluna.image.bc"
+
+-- image.blit_many : blits in bands, premultiplied alpha and edge extrusion
+
+local SIZE <const> = 64
+
+local function sprite(w, h, r, g, b, a)
+	return image.canvas(string.pack("BBBB", r, g, b, a):rep(w * h), w, h)
+end
+
+local red = sprite(8, 8, 255, 0, 0, 128)
+local blue = sprite(5, 7, 0, 0, 255, 255)
+
+local list = image.blit_list {
+	red, 2, 3,
+	blue, 20, 30,
+	-- clipped by the page
+	blue, SIZE - 2, -3,
+}
+
+local function ptr(img)
+	local _, _, p = image.canvas_size(img:canvas())
+	return p
+end
+
+local function expected()
+	local pixels = {}
+	local empty = string.pack("BBBB", 0, 0, 0, 0)
+	for i = 1, SIZE * SIZE do
+		pixels[i] = empty
+	end
+	local function fill(x0, y0, x1, y1, c)
+		for y = y0, y1 do
+			for x = x0, x1 do
+				pixels[y * SIZE + x + 1] = c
+			end
+		end
+	end
+	-- rects with 1 pixel extruded
+	fill(1, 2, 10, 11, string.pack("BBBB", 128, 0, 0, 128))
+	fill(19, 29, 25, 37, string.pack("BBBB", 0, 0, 255, 255))
+	fill(SIZE - 3, 0, SIZE - 1, 4, string.pack("BBBB", 0, 0, 255, 255))
+	return image.new(SIZE, SIZE, table.concat(pixels))
+end
+
+local function same(a, b)
+	return bc.psnr(ptr(a), ptr(b), SIZE, SIZE) == math.huge
+end
+
+local whole = image.new(SIZE, SIZE)
+image.blit_many(whole:canvas(), list, 0, SIZE, true, true)
+assert(same(whole, expected()))
+
+-- bands filled one by one (by different workers in loader) give the same result
+local banded = image.new(SIZE, SIZE)
+for y = 0, SIZE - 1, 13 do
+	image.blit_many(image.canvas(ptr(banded), SIZE, SIZE), list, y, y + 13, true, true)
+end
+assert(same(whole, banded))
+
+-- without options, it's the same as image.blit
+local plain = image.new(SIZE, SIZE)
+image.blit_many(plain:canvas(), list)
+local ref = image.new(SIZE, SIZE)
+image.blit(ref:canvas(), red, 2, 3)
+image.blit(ref:canvas(), blue, 20, 30)
+image.blit(ref:canvas(), blue, SIZE - 2, -3)
+assert(same(plain, ref))
+
+print "blit_many ok"
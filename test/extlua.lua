@@ -3,6 +3,7 @@
 local soluna = require "soluna"
 local foobar = require "ext.foobar"
 local matpq = require "ext.material.perspective_quad"
+local mattint = require "ext.material.tint_quad"
 
 print(foobar.hello())
 soluna.set_window_title "extlua perspective quad"
@@ -95,13 +96,25 @@ function callback.window_resize(w, h)
 	screen_h = h
 end
 
+-- a run of cards of the same material is drawn by one instanced draw call
+local CARD_N <const> = 5
+
 function callback.frame(count)
-	local theta = math.sin(count * 0.021) * 1.15
-	batch:add(matpq.sprite(card, {
-		sin_angle = math.sin(theta),
-		cos_angle = math.cos(theta),
-		color = WHITE,
-	}), screen_w * 0.5, screen_h * 0.5)
+	for i = 1, CARD_N do
+		local theta = math.sin(count * 0.021 + i * 0.4) * 1.15
+		batch:add(matpq.sprite(card, {
+			sin_angle = math.sin(theta),
+			cos_angle = math.cos(theta),
+			color = WHITE,
+		}), screen_w * i / (CARD_N + 1), screen_h * 0.5)
+	end
+	-- the tint is a per item uniform of tint_quad, in its item buffer
+	for i = 1, CARD_N do
+		local t = (count + i * 24) % 120 / 120
+		local c = math.floor(math.abs(t * 2 - 1) * 255)
+		batch:add(mattint.sprite(card, 0xff000000 | c << 16 | (255 - c) << 8 | 0x80),
+			screen_w * i / (CARD_N + 1), screen_h * 0.5 + CARD_H)
+	end
 end
 
 return callback
@@ -0,0 +1,54 @@
+local render = require "soluna.render"
+local matext = require "soluna.material.ext"
+local tintmat = require "ext.material.tint_quad"
+
+local ctx = ...
+local state = ctx.state
+local setting = ctx.settings
+
+tintmat.set_material_id(ctx.id)
+
+local inst_buffer = render.buffer {
+	type = "vertex",
+	usage = "stream",
+	label = "extlua-tint-quad-instance",
+	size = tintmat.instance_size * setting.draw_instance,
+}
+
+-- the tint of each item, read by the vertex shader from items[base + instance index]
+local item_buffer = render.buffer {
+	type = "storage",
+	usage = "dynamic",
+	label = "extlua-tint-quad-item",
+	size = tintmat.item_size * setting.draw_instance,
+}
+
+local bindings = render.bindings()
+bindings:vbuffer(0, inst_buffer)
+bindings:view(0, state.views.storage)
+bindings:view(2, render.view { storage = item_buffer })
+bindings:sampler(0, state.default_sampler)
+
+return matext.new {
+	id = ctx.id,
+	instance_size = tintmat.instance_size,
+	inst_buffer = inst_buffer,
+	bindings = bindings,
+	uniform = state.uniform,
+	item_uniform = render.uniform {
+		16, -- size
+		color = {
+			offset = 0,
+			type = "float",
+			n = 4,
+		},
+	},
+	item_buffer = item_buffer,
+	item_count = setting.draw_instance,
+	sr_buffer = state.srbuffer_mem,
+	sprite_bank = ctx.arg.bank_ptr,
+	texture_views = state.views,
+	texture_view_slot = 1,
+	hooks = tintmat.hooks,
+	label = "extlua-tint-quad-pipeline",
+}
@@ -0,0 +1,69 @@
+-- To run this sample :
+-- bin/soluna.exe entry=test/layer.lua
+local soluna = require "soluna"
+local spritemgr = require "soluna.spritemgr"
+local ltask = require "ltask"
+
+-- A static background of 10k sprites is drawn into a cached layer once,
+-- later frames draw only one sprite for it. The layer is redrawn every 120 frames.
+
+soluna.set_window_title "soluna cached layer"
+
+soluna.preload {
+	{
+		filename = "@layer_red",
+		content = string.pack("BBBB", 255, 64, 64, 255):rep(8 * 8),
+		w = 8,
+		h = 8,
+	},
+	{
+		filename = "@layer_blue",
+		content = string.pack("BBBB", 64, 64, 255, 255):rep(8 * 8),
+		w = 8,
+		h = 8,
+	},
+}
+
+local sprites = soluna.load_sprites {
+	{ name = "red", filename = "@layer_red" },
+	{ name = "blue", filename = "@layer_blue" },
+}
+
+local args = ...
+local batch = args.batch
+local render = ltask.uniqueservice "render"
+
+local W <const> = 1000
+local H <const> = 1000
+
+local layer = soluna.layer(W, H)
+local content = spritemgr.newbatch()
+
+local function build(phase)
+	content:reset()
+	for y = 0, H - 10, 10 do
+		for x = 0, W - 10, 10 do
+			local s = ((x + y) // 10 + phase) % 2 == 0 and sprites.red or sprites.blue
+			content:add(s, x, y)
+		end
+	end
+	layer:update(content)
+end
+
+build(0)
+
+local callback = {}
+
+function callback.frame(count)
+	if count % 120 == 0 then
+		build(count // 120)
+	end
+	local dx = math.sin(count / 60) * 20
+	batch:add(layer.id, 10 + dx, 10)
+	if count % 120 == 1 then
+		local n, peak = ltask.call(render, "draw_stat")
+		print(string.format("frame %d : %d draws, peak %d", count, n, peak))
+	end
+end
+
+return callback
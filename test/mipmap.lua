@@ -0,0 +1,57 @@
+local soluna = require "soluna"
+
+-- Checkerboard sprites zooming out to 1/32.
+-- Run mipmap.game (single level atlas) and mipmap_trilinear.game (atlas with mipmaps) to compare the aliasing.
+-- mipmap_bc.game uses BC3 compressed atlas with mipmaps.
+-- mipmap_premultiply.game uses premultiplied alpha. With mipmaps, the sprites are extruded 1 pixel in the atlas.
+
+soluna.set_window_title "soluna mipmap"
+
+local args = ...
+local batch = args.batch
+local setting = soluna.settings()
+
+local SIZE <const> = 64
+local CELL <const> = 4
+
+local function checker()
+	local white = string.pack("BBBB", 255, 255, 255, 255)
+	local black = string.pack("BBBB", 32, 32, 32, 255)
+	local p = {}
+	for y = 0, SIZE - 1 do
+		for x = 0, SIZE - 1 do
+			p[#p+1] = ((x // CELL + y // CELL) % 2 == 0) and white or black
+		end
+	end
+	return table.concat(p)
+end
+
+soluna.preload {
+	filename = "@mipmap_checker",
+	content = checker(),
+	w = SIZE,
+	h = SIZE,
+}
+
+local sprites = soluna.load_sprites {
+	{ name = "checker", filename = "@mipmap_checker" },
+}
+
+print("atlas_mipmap", setting.atlas_mipmap)
+
+local callback = {}
+
+function callback.frame(count)
+	-- scale from 1 to 1/32 and back
+	local scale = 2 ^ (-2.5 - 2.5 * math.cos(count / 120))
+	local step = SIZE * scale + 1
+	batch:layer(scale, 0, 0)
+	for y = 0, args.height, step do
+		for x = 0, args.width, step do
+			batch:add(sprites.checker, x / scale, y / scale)
+		end
+	end
+	batch:layer()
+end
+
+return callback
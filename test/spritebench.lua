@@ -0,0 +1,60 @@
+local soluna = require "soluna"
+local ltask = require "ltask"
+
+-- 100k small sprites per frame.
+-- Run spritebench.game (24 bytes instances) and spritebench_compact.game (16 bytes instances) to compare,
+-- it prints the frame interval and the bytes of sprite instances uploaded per frame.
+
+soluna.set_window_title "soluna sprite benchmark"
+
+local args = ...
+local batch = args.batch
+local setting = soluna.settings()
+local render = ltask.uniqueservice "render"
+
+local SPRITES <const> = 100000
+local COLUMN <const> = 400
+local SIZE <const> = 4
+
+local function make_sprite()
+	local pixel = string.pack("BBBB", 255, 160, 64, 255)
+	soluna.preload {
+		filename = "@spritebench_dot",
+		content = pixel:rep(SIZE * SIZE),
+		w = SIZE,
+		h = SIZE,
+	}
+	return soluna.load_sprites {
+		{ name = "dot", filename = "@spritebench_dot" },
+	}
+end
+
+local dot = assert(make_sprite().dot)
+
+local callback = {}
+
+local last
+local frames = 0
+
+function callback.frame(count)
+	local w = args.width / COLUMN
+	local h = args.height / (SPRITES // COLUMN)
+	for i = 0, SPRITES - 1 do
+		batch:add(dot, i % COLUMN * w, (i // COLUMN * h + count) % args.height)
+	end
+	frames = frames + 1
+	local _, now = ltask.now()
+	if last == nil then
+		last = now
+	elseif now - last >= 200 then
+		local bytes = ltask.call(render, "sprite_instance_bytes")
+		local draw_n, draw_peak, draw_cap = ltask.call(render, "draw_stat")
+		print(string.format("%d sprites (%s) : %.2f ms per frame, %d bytes uploaded, draw %d/%d/%d",
+			SPRITES, setting.sprite_compact and "compact" or "default", (now - last) * 10 / frames, bytes,
+			draw_n, draw_peak, draw_cap))
+		last = now
+		frames = 0
+	end
+end
+
+return callback
@@ -19,3 +19,17 @@ for i = 1, n do
 	print_r(i, r)
 end
 
+-- remove sprites, the free space is reclaimed by compact
+bank:remove(3)
+bank:remove(1)
+print_r("Pages", bank:pages())
+
+texid, n = bank:compact()
+print("Compact",n,"from",texid)
+for i = 1, n do
+	print_r(i, bank:altas(texid + i - 1))
+end
+
+-- the id of removed sprite is reused
+print("Add", bank:add(16, 16))
+print("Stat", bank:stat())
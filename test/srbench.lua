@@ -0,0 +1,44 @@
+local soluna = require "soluna"
+local ltask = require "ltask"
+local matquad = require "soluna.material.quad"
+
+-- Quads with (almost) all different scale/rotation, changing every frame.
+-- Run srbench.game (sr buffer) and srbench_direct.game (sr decoded in vertex shader) to compare.
+
+soluna.set_window_title "soluna sr benchmark"
+
+local args = ...
+local batch = args.batch
+local setting = soluna.settings()
+
+local QUADS <const> = 40000
+local COLUMN <const> = 200
+local quad = matquad.quad(8, 8, 0xff4080ff)
+
+local callback = {}
+
+local last
+local frames = 0
+
+function callback.frame(count)
+	local w = args.width / COLUMN
+	local h = args.height / (QUADS // COLUMN)
+	for i = 0, QUADS - 1 do
+		local scale = 0.5 + (i % 251) / 128
+		local rot = (i + count) * 0.0015
+		batch:layer(scale, rot, i % COLUMN * w, i // COLUMN * h)
+		batch:add(quad)
+		batch:layer()
+	end
+	frames = frames + 1
+	local _, now = ltask.now()
+	if last == nil then
+		last = now
+	elseif now - last >= 200 then
+		print(string.format("%d quads (%s) : %.2f ms per frame", QUADS, setting.sr_direct and "direct sr" or "sr buffer", (now - last) * 10 / frames))
+		last = now
+		frames = 0
+	end
+end
+
+return callback
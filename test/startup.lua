@@ -0,0 +1,23 @@
+local soluna = require "soluna"
+local app = require "soluna.app"
+local trace = require "soluna.trace"
+
+-- Startup benchmark : loads a sprite bundle, prints the startup timeline and quits.
+-- The chrome trace (chrome://tracing or https://ui.perfetto.dev) is written to startup_trace.json at the first frame.
+
+trace.begin "load_sprites"
+soluna.load_sprites "asset/sprites.dl"
+trace.finish "load_sprites"
+
+local FRAMES <const> = 3
+
+local callback = {}
+
+function callback.frame(count)
+	if count == FRAMES then
+		print(trace.report())
+		app.quit()
+	end
+end
+
+return callback
@@ -0,0 +1,80 @@
+local soluna = require "soluna"
+local ltask = require "ltask"
+local mattext = require "soluna.material.text"
+local font = require "soluna.font"
+local arena = require "soluna.arena"
+
+-- 50k glyphs of static text, most of them repeated in a frame.
+-- Prints average frame interval, run with and without vsync limit to compare text submit cost.
+-- The frame counter is a transient block rebuilt every frame from the frame arena.
+
+local function font_init()
+	local sysfont = require "soluna.font.system"
+	local candidates = {
+		"WenQuanYi Micro Hei",    -- Linux
+		"Microsoft YaHei",        -- Windows
+		"Yuanti SC",              -- macOS
+	}
+	for _, name in ipairs(candidates) do
+		local ok, data = pcall(sysfont.ttfdata, name)
+		if ok and data then
+			font.import(data)
+			local fontid = font.name(name)
+			if fontid then
+				return fontid
+			end
+		end
+	end
+	error "No available system font for text benchmark"
+end
+
+soluna.set_window_title "soluna text benchmark"
+
+local args = ...
+local batch = args.batch
+local fontid = font_init()
+local fontcobj = font.cobj()
+
+local GLYPHS <const> = 50000
+local LINE <const> = 250
+local LINE_HEIGHT <const> = 14
+local SIZE <const> = 12
+
+local line = {}
+local chars = "The quick brown fox jumps over the lazy dog. 0123456789 "
+for i = 1, LINE do
+	local idx = (i - 1) % #chars + 1
+	line[i] = chars:sub(idx, idx)
+end
+line = table.concat(line)
+
+local block = mattext.block(fontcobj, fontid, SIZE, 0xffffff, "LT")
+local labels = {}
+for i = 1, GLYPHS // LINE do
+	labels[i] = block(line, LINE * SIZE, LINE_HEIGHT)
+end
+
+local callback = {}
+
+local last
+local frames = 0
+
+function callback.frame(count)
+	for i = 1, #labels do
+		batch:add(labels[i], 0, (i - 1) * LINE_HEIGHT % args.height)
+	end
+	batch:add(block("frame " .. count, LINE * SIZE, LINE_HEIGHT, true), 0, 0)
+	frames = frames + 1
+	local _, now = ltask.now()
+	if last == nil then
+		last = now
+	elseif now - last >= 200 then
+		print(string.format("%d glyphs : %.2f ms per frame", GLYPHS, (now - last) * 10 / frames))
+		local stat = arena.stat()
+		print(string.format("frame arena : %d bytes in %d allocs, %d overflow, peak %d", stat.bytes, stat.count, stat.overflow, stat.peak))
+		last = now
+		frames = 0
+	end
+end
+
+return callback